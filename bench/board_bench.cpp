@@ -0,0 +1,334 @@
+
+#include "board.hpp"
+#include "move_picker.hpp"
+#include "nnue.hpp"
+#include "perft.hpp"
+#include "search.hpp"
+#include "tt.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+// Micro-benchmarks of the Board hot paths. Every benchmark runs once per
+// position class, so a regression can be traced to the kind of position it
+// affects, e.g. BM_GenerateLegal/middlegame.
+
+namespace {
+
+const std::vector<std::string> opening_fens = {
+    Board::start_fen,
+    "rnbqkbnr/pp1ppppp/8/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2",
+    "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3",
+    "rnbqkb1r/ppp2ppp/4pn2/3p4/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 2 4",
+};
+
+const std::vector<std::string> middlegame_fens = {
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 8",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+};
+
+const std::vector<std::string> endgame_fens = {
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "1K1k4/1P6/8/8/8/8/r7/2R5 w - - 0 1",
+};
+
+std::vector<Board> make_boards(const std::vector<std::string> &fens) {
+  return std::vector<Board>(fens.begin(), fens.end());
+}
+
+void BM_BoardFromFen(benchmark::State &state,
+                     const std::vector<std::string> &fens) {
+  for (auto _ : state) {
+    for (const std::string &fen : fens) {
+      Board board(fen);
+      benchmark::DoNotOptimize(board);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * fens.size());
+}
+
+// set_fen on a board that already exists, as the bulk loader uses it
+void BM_SetFen(benchmark::State &state, const std::vector<std::string> &fens) {
+  Board board;
+  for (auto _ : state) {
+    for (const std::string &fen : fens)
+      benchmark::DoNotOptimize(board.set_fen(fen));
+  }
+  state.SetItemsProcessed(state.iterations() * fens.size());
+}
+
+void BM_ToFen(benchmark::State &state, const std::vector<std::string> &fens) {
+  const std::vector<Board> boards = make_boards(fens);
+  for (auto _ : state) {
+    for (const Board &board : boards)
+      benchmark::DoNotOptimize(board.to_fen());
+  }
+  state.SetItemsProcessed(state.iterations() * boards.size());
+}
+
+template <GenType Type>
+void generate_benchmark(benchmark::State &state,
+                        const std::vector<std::string> &fens) {
+  const std::vector<Board> boards = make_boards(fens);
+  for (auto _ : state) {
+    for (const Board &board : boards) {
+      MoveList moves;
+      board.generate<Type>(moves);
+      benchmark::DoNotOptimize(moves);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * boards.size());
+}
+
+void BM_GeneratePseudoLegal(benchmark::State &state,
+                            const std::vector<std::string> &fens) {
+  generate_benchmark<PseudoLegal>(state, fens);
+}
+
+void BM_GenerateLegal(benchmark::State &state,
+                      const std::vector<std::string> &fens) {
+  generate_benchmark<Legal>(state, fens);
+}
+
+void BM_GenerateCaptures(benchmark::State &state,
+                         const std::vector<std::string> &fens) {
+  generate_benchmark<Captures>(state, fens);
+}
+
+void BM_GenerateQuiets(benchmark::State &state,
+                       const std::vector<std::string> &fens) {
+  generate_benchmark<Quiets>(state, fens);
+}
+
+// the cost of getting the first move out of a MovePicker with no hash move,
+// which is all a node that cuts off on its first capture pays for
+void BM_MovePickerFirstMove(benchmark::State &state,
+                            const std::vector<std::string> &fens) {
+  const std::vector<Board> boards = make_boards(fens);
+  for (auto _ : state) {
+    for (const Board &board : boards) {
+      MovePicker picker(board, PackedMove::none());
+      benchmark::DoNotOptimize(picker.next_move());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * boards.size());
+}
+
+// one item is a make_move/unmake_move pair, over every legal move
+void BM_MakeUnmake(benchmark::State &state,
+                   const std::vector<std::string> &fens) {
+  std::vector<Board> boards = make_boards(fens);
+  std::vector<MoveList> moves(boards.size());
+  int64_t pairs = 0;
+  for (size_t i = 0; i < boards.size(); ++i) {
+    boards[i].generate<Legal>(moves[i]);
+    pairs += moves[i].size();
+  }
+  for (auto _ : state) {
+    for (size_t i = 0; i < boards.size(); ++i) {
+      for (const PackedMove move : moves[i]) {
+        benchmark::DoNotOptimize(boards[i].make_move(move));
+        boards[i].unmake_move();
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * pairs);
+}
+
+// one item is a query, for every square and both sides
+void BM_IsSquareAttacked(benchmark::State &state,
+                         const std::vector<std::string> &fens) {
+  const std::vector<Board> boards = make_boards(fens);
+  for (auto _ : state) {
+    for (const Board &board : boards) {
+      for (square_t sq = 0; sq < 64; ++sq) {
+        benchmark::DoNotOptimize(board.is_square_attacked(sq, White));
+        benchmark::DoNotOptimize(board.is_square_attacked(sq, Black));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * boards.size() * 128);
+}
+
+// one item is an exchange evaluation of a capture
+void BM_SeeCaptures(benchmark::State &state,
+                    const std::vector<std::string> &fens) {
+  const std::vector<Board> boards = make_boards(fens);
+  std::vector<MoveList> captures(boards.size());
+  int64_t count = 0;
+  for (size_t i = 0; i < boards.size(); ++i) {
+    boards[i].generate<Captures>(captures[i]);
+    count += captures[i].size();
+  }
+  for (auto _ : state) {
+    for (size_t i = 0; i < boards.size(); ++i)
+      for (const PackedMove move : captures[i])
+        benchmark::DoNotOptimize(boards[i].see_ge(move));
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+// the draw check the search makes at every node
+void BM_IsDraw(benchmark::State &state, const std::vector<std::string> &fens) {
+  const std::vector<Board> boards = make_boards(fens);
+  for (auto _ : state) {
+    for (const Board &board : boards)
+      benchmark::DoNotOptimize(board.is_draw(1));
+  }
+  state.SetItemsProcessed(state.iterations() * boards.size());
+}
+
+void BM_StaticEvaluation(benchmark::State &state,
+                         const std::vector<std::string> &fens) {
+  const std::vector<Board> boards = make_boards(fens);
+  PawnHashTable pawn_table;
+  for (auto _ : state) {
+    for (const Board &board : boards)
+      benchmark::DoNotOptimize(board.static_evaluation(pawn_table));
+  }
+  state.SetItemsProcessed(state.iterations() * boards.size());
+}
+
+void BM_GetKingSquare(benchmark::State &state,
+                      const std::vector<std::string> &fens) {
+  const std::vector<Board> boards = make_boards(fens);
+  for (auto _ : state) {
+    for (const Board &board : boards) {
+      benchmark::DoNotOptimize(board.get_king_square(White));
+      benchmark::DoNotOptimize(board.get_king_square(Black));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * boards.size() * 2);
+}
+
+// Evaluations/second of the neural network against BM_StaticEvaluation. No
+// trained network ships with the source, so these use random weights, which
+// cost exactly as much to evaluate. The label names the SIMD kernels in use.
+void BM_NnueEvaluation(benchmark::State &state,
+                       const std::vector<std::string> &fens) {
+  nnue_network.randomize(1);
+  const std::vector<Board> boards = make_boards(fens);
+  for (auto _ : state) {
+    for (const Board &board : boards)
+      benchmark::DoNotOptimize(board.nnue_evaluation());
+  }
+  state.SetItemsProcessed(state.iterations() * boards.size());
+  state.SetLabel(simd_level_name(get_simd_level()));
+  nnue_network.unload();
+}
+
+// BM_MakeUnmake with the accumulator updated on every move
+void BM_NnueMakeUnmake(benchmark::State &state,
+                       const std::vector<std::string> &fens) {
+  nnue_network.randomize(1);
+  BM_MakeUnmake(state, fens);
+  state.SetLabel(simd_level_name(get_simd_level()));
+  nnue_network.unload();
+}
+
+// one item is a perft node; the depth is the benchmark argument
+void BM_Perft(benchmark::State &state, const std::vector<std::string> &fens) {
+  std::vector<Board> boards = make_boards(fens);
+  uint64_t nodes = 0;
+  for (auto _ : state) {
+    for (Board &board : boards)
+      nodes += perft(board, static_cast<int>(state.range(0)));
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(nodes));
+}
+
+// one item is a search node; the depth is the benchmark argument. The table and
+// the move ordering state are cleared before every search so each one starts
+// cold.
+void BM_Search(benchmark::State &state, const std::vector<std::string> &fens) {
+  std::vector<Board> boards = make_boards(fens);
+  SearchLimits limits;
+  limits.depth = static_cast<int>(state.range(0));
+  if (tt.size_mb() == 0)
+    tt.resize(TranspositionTable::default_mb);
+  SearchPool search;
+  uint64_t nodes = 0;
+  for (auto _ : state) {
+    for (const Board &board : boards) {
+      state.PauseTiming();
+      search.clear();
+      state.ResumeTiming();
+      search.start(board, limits);
+      nodes += search.run(board, limits).nodes;
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(nodes));
+}
+
+// Lazy SMP scaling: the time to reach a fixed depth and the nodes per second
+// with the thread count as the benchmark argument. Both are wall clock, since
+// CPU time adds up over the threads.
+void BM_SearchThreads(benchmark::State &state,
+                      const std::vector<std::string> &fens) {
+  std::vector<Board> boards = make_boards(fens);
+  SearchLimits limits;
+  limits.depth = 7;
+  if (tt.size_mb() == 0)
+    tt.resize(TranspositionTable::default_mb);
+  SearchPool search(static_cast<int>(state.range(0)));
+  uint64_t nodes = 0;
+  for (auto _ : state) {
+    for (const Board &board : boards) {
+      state.PauseTiming();
+      search.clear();
+      state.ResumeTiming();
+      search.start(board, limits);
+      nodes += search.run(board, limits).nodes;
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(nodes));
+  state.counters["threads"] = static_cast<double>(state.range(0));
+}
+
+#define STARFISH_BENCHMARK_CLASSES(bm)                                         \
+  BENCHMARK_CAPTURE(bm, opening, opening_fens);                                \
+  BENCHMARK_CAPTURE(bm, middlegame, middlegame_fens);                          \
+  BENCHMARK_CAPTURE(bm, endgame, endgame_fens)
+
+STARFISH_BENCHMARK_CLASSES(BM_BoardFromFen);
+STARFISH_BENCHMARK_CLASSES(BM_SetFen);
+STARFISH_BENCHMARK_CLASSES(BM_ToFen);
+STARFISH_BENCHMARK_CLASSES(BM_GeneratePseudoLegal);
+STARFISH_BENCHMARK_CLASSES(BM_GenerateLegal);
+STARFISH_BENCHMARK_CLASSES(BM_GenerateCaptures);
+STARFISH_BENCHMARK_CLASSES(BM_GenerateQuiets);
+STARFISH_BENCHMARK_CLASSES(BM_MovePickerFirstMove);
+STARFISH_BENCHMARK_CLASSES(BM_MakeUnmake);
+STARFISH_BENCHMARK_CLASSES(BM_IsSquareAttacked);
+STARFISH_BENCHMARK_CLASSES(BM_SeeCaptures);
+STARFISH_BENCHMARK_CLASSES(BM_IsDraw);
+STARFISH_BENCHMARK_CLASSES(BM_StaticEvaluation);
+STARFISH_BENCHMARK_CLASSES(BM_GetKingSquare);
+STARFISH_BENCHMARK_CLASSES(BM_NnueEvaluation);
+STARFISH_BENCHMARK_CLASSES(BM_NnueMakeUnmake);
+BENCHMARK_CAPTURE(BM_Perft, opening, opening_fens)->DenseRange(1, 3);
+BENCHMARK_CAPTURE(BM_Perft, middlegame, middlegame_fens)->DenseRange(1, 3);
+BENCHMARK_CAPTURE(BM_Perft, endgame, endgame_fens)->DenseRange(1, 3);
+BENCHMARK_CAPTURE(BM_Search, opening, opening_fens)->Arg(6);
+BENCHMARK_CAPTURE(BM_Search, middlegame, middlegame_fens)->Arg(5);
+BENCHMARK_CAPTURE(BM_Search, endgame, endgame_fens)->Arg(8);
+BENCHMARK_CAPTURE(BM_SearchThreads, opening, opening_fens)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_SearchThreads, middlegame, middlegame_fens)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
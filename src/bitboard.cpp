@@ -0,0 +1,149 @@
+
+#include "bitboard.hpp"
+
+#include <array>
+#include <utility>
+
+Magic bishop_magics[64];
+Magic rook_magics[64];
+bitboard_t between_table[64][64];
+bitboard_t line_table[64][64];
+
+namespace {
+
+// every square's block of the table holds 2^(number of relevant blockers)
+// entries: these totals are the sums of those block sizes over the board
+bitboard_t bishop_table[0x1480];
+bitboard_t rook_table[0x19000];
+
+using Direction = std::pair<int, int>;
+
+const std::array<Direction, 4> bishop_directions = {
+    std::make_pair(1, 1), std::make_pair(-1, 1), std::make_pair(1, -1),
+    std::make_pair(-1, -1)};
+const std::array<Direction, 4> rook_directions = {
+    std::make_pair(1, 0), std::make_pair(-1, 0), std::make_pair(0, 1),
+    std::make_pair(0, -1)};
+
+// the slow, square by square attack walk: only used to fill the tables
+bitboard_t sliding_attacks(const std::array<Direction, 4> &directions,
+                           const square_t sq, const bitboard_t occupied) {
+  bitboard_t attacks = 0;
+  for (const auto &[dx, dy] : directions) {
+    int file = square_file(sq) + dx, rank = square_rank(sq) + dy;
+    while (0 <= file && file <= 7 && 0 <= rank && rank <= 7) {
+      const square_t target = square_from_file_rank(file, rank);
+      attacks |= square_bb(target);
+      if (occupied & square_bb(target))
+        break;
+      file += dx;
+      rank += dy;
+    }
+  }
+  return attacks;
+}
+
+// xorshift64*: a small deterministic generator so the magics found are the
+// same on every run
+class MagicRng {
+  uint64_t state;
+
+public:
+  explicit MagicRng(const uint64_t seed) : state(seed) {}
+
+  uint64_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+  }
+
+  // magics with few set bits are found much faster
+  uint64_t sparse() { return next() & next() & next(); }
+};
+
+void init_magics(const std::array<Direction, 4> &directions, bitboard_t *table,
+                 Magic magics[64]) {
+#ifndef __BMI2__
+  bitboard_t occupancy[4096], reference[4096];
+  int epoch[4096] = {}, attempt = 0;
+  MagicRng rng(728);
+#endif
+
+  bitboard_t *block = table;
+  for (square_t sq = 0; sq < 64; ++sq) {
+    // a piece on the edge of the board never blocks anything behind it, so
+    // the edges are left out of the mask
+    const bitboard_t edges =
+        ((rank_1_bb | rank_8_bb) & ~(rank_8_bb << (8 * (sq / 8)))) |
+        ((file_a_bb | file_h_bb) & ~(file_a_bb << square_file(sq)));
+
+    Magic &m = magics[sq];
+    m.mask = sliding_attacks(directions, sq, 0) & ~edges;
+    m.shift = 64 - popcount(m.mask);
+    m.attacks = block;
+
+    // enumerate every subset of the mask (Carry-Rippler)
+    int size = 0;
+    bitboard_t subset = 0;
+    do {
+#ifdef __BMI2__
+      m.attacks[m.index(subset)] = sliding_attacks(directions, sq, subset);
+#else
+      occupancy[size] = subset;
+      reference[size] = sliding_attacks(directions, sq, subset);
+#endif
+      size++;
+      subset = (subset - m.mask) & m.mask;
+    } while (subset);
+    block += size;
+
+#ifndef __BMI2__
+    // try random candidates until one maps every subset without a
+    // destructive collision; epoch avoids clearing the block between tries
+    for (int i = 0; i < size;) {
+      for (m.magic = 0; popcount((m.magic * m.mask) >> 56) < 6;)
+        m.magic = rng.sparse();
+
+      ++attempt;
+      for (i = 0; i < size; ++i) {
+        const unsigned idx = m.index(occupancy[i]);
+        if (epoch[idx] < attempt) {
+          epoch[idx] = attempt;
+          m.attacks[idx] = reference[i];
+        } else if (m.attacks[idx] != reference[i]) {
+          break;
+        }
+      }
+    }
+#endif
+  }
+}
+
+void init_lines() {
+  for (square_t a = 0; a < 64; ++a) {
+    for (square_t b = 0; b < 64; ++b) {
+      const bitboard_t ends = square_bb(a) | square_bb(b);
+      if (a != b && (rook_attacks(a, 0) & square_bb(b))) {
+        line_table[a][b] = (rook_attacks(a, 0) & rook_attacks(b, 0)) | ends;
+        between_table[a][b] =
+            rook_attacks(a, square_bb(b)) & rook_attacks(b, square_bb(a));
+      } else if (a != b && (bishop_attacks(a, 0) & square_bb(b))) {
+        line_table[a][b] = (bishop_attacks(a, 0) & bishop_attacks(b, 0)) | ends;
+        between_table[a][b] =
+            bishop_attacks(a, square_bb(b)) & bishop_attacks(b, square_bb(a));
+      }
+    }
+  }
+}
+
+// fills the slider tables before main() runs
+struct BitboardInit {
+  BitboardInit() {
+    init_magics(bishop_directions, bishop_table, bishop_magics);
+    init_magics(rook_directions, rook_table, rook_magics);
+    init_lines();
+  }
+} bitboard_init;
+
+} // namespace
@@ -0,0 +1,104 @@
+
+#pragma once
+
+#include "colour.hpp"
+#include "square.hpp"
+
+#include <cstdint>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+constexpr bitboard_t square_bb(const square_t sq) {
+  return bitboard_t(1) << sq;
+}
+
+constexpr bitboard_t file_a_bb = 0x0101010101010101ULL;
+constexpr bitboard_t file_h_bb = file_a_bb << 7;
+constexpr bitboard_t rank_8_bb = 0xFFULL;
+constexpr bitboard_t rank_1_bb = rank_8_bb << 56;
+// a1, c1, ..., b2, ...: the squares a bishop on a1 can reach
+constexpr bitboard_t dark_squares_bb = 0x55AA55AA55AA55AAULL;
+
+inline int popcount(const bitboard_t bb) { return __builtin_popcountll(bb); }
+
+// index of the lowest set bit: bb must be non-empty
+inline square_t lsb(const bitboard_t bb) { return __builtin_ctzll(bb); }
+
+// removes the lowest set bit from bb and returns its index
+inline square_t pop_lsb(bitboard_t &bb) {
+  const square_t sq = lsb(bb);
+  bb &= bb - 1;
+  return sq;
+}
+
+// squares a pawn of the given side on sq attacks
+constexpr bitboard_t pawn_attacks_bb(const square_t sq, const colour_t side) {
+  return pawn_attack_table[colour_index(side)][sq];
+}
+
+// squares from which a pawn of the given side attacks sq
+constexpr bitboard_t pawn_attackers_bb(const square_t sq,
+                                       const colour_t side) {
+  return pawn_attack_table[colour_index(-side)][sq];
+}
+
+// squares a knight on sq attacks
+constexpr bitboard_t knight_attacks_bb(const square_t sq) {
+  return knight_attack_table[sq];
+}
+
+// squares a king on sq attacks
+constexpr bitboard_t king_attacks_bb(const square_t sq) {
+  return king_attack_table[sq];
+}
+
+// Fancy magic bitboards: the relevant blockers of a slider on a square are
+// hashed into a dense per-square block of the attack table. On BMI2 machines
+// PEXT does the hashing exactly, so the magic multiplier goes unused.
+struct Magic {
+  bitboard_t mask;
+  bitboard_t magic;
+  bitboard_t *attacks;
+  unsigned shift;
+
+  inline unsigned index(const bitboard_t occupied) const {
+#ifdef __BMI2__
+    return static_cast<unsigned>(_pext_u64(occupied, mask));
+#else
+    return static_cast<unsigned>(((occupied & mask) * magic) >> shift);
+#endif
+  }
+};
+
+extern Magic bishop_magics[64];
+extern Magic rook_magics[64];
+
+inline bitboard_t bishop_attacks(const square_t sq, const bitboard_t occupied) {
+  const Magic &m = bishop_magics[sq];
+  return m.attacks[m.index(occupied)];
+}
+
+inline bitboard_t rook_attacks(const square_t sq, const bitboard_t occupied) {
+  const Magic &m = rook_magics[sq];
+  return m.attacks[m.index(occupied)];
+}
+
+inline bitboard_t queen_attacks(const square_t sq, const bitboard_t occupied) {
+  return bishop_attacks(sq, occupied) | rook_attacks(sq, occupied);
+}
+
+extern bitboard_t between_table[64][64];
+extern bitboard_t line_table[64][64];
+
+// squares strictly between a and b if they share a rank, file or diagonal,
+// otherwise empty
+inline bitboard_t between_bb(const square_t a, const square_t b) {
+  return between_table[a][b];
+}
+
+// the whole rank, file or diagonal through a and b, or empty if there is none
+inline bitboard_t line_bb(const square_t a, const square_t b) {
+  return line_table[a][b];
+}
@@ -1,58 +1,494 @@
 
 #include "board.hpp"
 
-#include "utils.hpp"
+#include "eval.hpp"
+#include "tt.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <string>
-#include <utility>
-#include <vector>
+#include <system_error>
 
-Board::Board(const std::string &fen) {
-  const std::vector<std::string> tokens = split_string(fen, ' ');
-  const std::string fen_pieces = remove_char(tokens[0], '/');
-  const std::string side_to_move_str = tokens[1], castle_perms_str = tokens[2],
-                    en_passant_str = tokens[3], fifty_move_str = tokens[4],
-                    full_move_str = tokens[5];
+namespace {
 
+// everything that move generation and make_move need to know about one side,
+// so that code templated on the side to move never branches on its colour
+template <Colour Us> struct ColourTraits {
+  static constexpr Colour them = Us == White ? Black : White;
+
+  static constexpr piece_t pawn = make_piece(Us, Pawn);
+  static constexpr piece_t knight = make_piece(Us, Knight);
+  static constexpr piece_t bishop = make_piece(Us, Bishop);
+  static constexpr piece_t rook = make_piece(Us, Rook);
+  static constexpr piece_t queen = make_piece(Us, Queen);
+  static constexpr piece_t king = make_piece(Us, King);
+
+  static constexpr int forward = Us == White ? -8 : 8;
+  static constexpr int start_rank = Us == White ? 1 : 6;
+  // the rank a pawn promotes from
+  static constexpr int last_rank = Us == White ? 6 : 1;
+
+  static constexpr int short_castle = Us == White ? WhiteShort : BlackShort;
+  static constexpr int long_castle = Us == White ? WhiteLong : BlackLong;
+  static constexpr square_t king_start = Us == White ? E1 : E8;
+  // the king crosses pass and lands on to; the squares in empty must be clear
+  static constexpr square_t short_pass = Us == White ? F1 : F8;
+  static constexpr square_t short_to = Us == White ? G1 : G8;
+  static constexpr bitboard_t short_empty =
+      square_bb(short_pass) | square_bb(short_to);
+  static constexpr square_t long_pass = Us == White ? D1 : D8;
+  static constexpr square_t long_to = Us == White ? C1 : C8;
+  static constexpr bitboard_t long_empty = square_bb(long_pass) |
+                                           square_bb(long_to) |
+                                           square_bb(Us == White ? B1 : B8);
+  static constexpr square_t short_rook_from = Us == White ? H1 : H8;
+  static constexpr square_t long_rook_from = Us == White ? A1 : A8;
+  // the rook lands on the square the king passes
+  static constexpr square_t short_rook_to = short_pass;
+  static constexpr square_t long_rook_to = long_pass;
+};
+
+// whether side By attacks sq, for a board with these pieces
+template <Colour By>
+bool attacked_by(const square_t sq, const bitboard_t (&piece_bb)[16],
+                 const bitboard_t occupied) {
+  using Side = ColourTraits<By>;
+  if ((pawn_attackers_bb(sq, By) & piece_bb[Side::pawn]) ||
+      (knight_attacks_bb(sq) & piece_bb[Side::knight]) ||
+      (king_attacks_bb(sq) & piece_bb[Side::king]))
+    return true;
+
+  // Sliders: look up the rays from the square itself and see whether they
+  // hit an enemy slider of the right kind
+  const bitboard_t queens = piece_bb[Side::queen];
+  if (rook_attacks(sq, occupied) & (piece_bb[Side::rook] | queens))
+    return true;
+  if (bishop_attacks(sq, occupied) & (piece_bb[Side::bishop] | queens))
+    return true;
+
+  return false;
+}
+
+} // namespace
+
+namespace {
+
+constexpr const char *field_separators = " \t\r\n";
+
+// splits the next whitespace separated field off the front of rest: empty once
+// there are no fields left
+std::string_view next_field(std::string_view &rest) {
+  const size_t start = rest.find_first_not_of(field_separators);
+  if (start == std::string_view::npos) {
+    rest = {};
+    return {};
+  }
+  rest.remove_prefix(start);
+  const size_t end =
+      std::min(rest.find_first_of(field_separators), rest.size());
+  const std::string_view field = rest.substr(0, end);
+  rest.remove_prefix(end);
+  return field;
+}
+
+// a whole field holding a non-negative number which fits in an int
+bool parse_counter(const std::string_view field, int &value) {
+  const char *end = field.data() + field.size();
+  const auto [parsed_end, error] = std::from_chars(field.data(), end, value);
+  return error == std::errc() && parsed_end == end && value >= 0;
+}
+
+} // namespace
+
+Board::Board(const std::string_view fen) {
+  const FenError error = set_fen(fen);
+  // a constructor can't report the error, and carrying on with some other
+  // position would give wrong answers quietly, so stop even without asserts
+  if (error != FenOk) {
+    std::cerr << "invalid FEN \"" << fen << "\": " << fen_error_message(error)
+              << " (use set_fen to handle errors)" << std::endl;
+    std::abort();
+  }
+}
+
+FenError Board::set_fen(const std::string_view fen) {
+  // everything is parsed and checked before the board is touched, so a bad
+  // FEN leaves the board as it was
+  std::string_view rest = fen;
+  const std::string_view placement_field = next_field(rest);
+  const std::string_view side_field = next_field(rest);
+  const std::string_view castle_field = next_field(rest);
+  const std::string_view en_passant_field = next_field(rest);
+
+  piece_t new_pieces[64];
   square_t square = 0;
-  for (const char c : fen_pieces) {
-    if ('1' <= c && c <= '8') {
-      const int num = c - '0';
-      for (int i = 0; i < num; i++) {
-        pieces[square++] = InvalidPiece;
+  int file = 0;
+  for (const char c : placement_field) {
+    if (c == '/') {
+      if (file != 8 || square == 64)
+        return FenBadPieces;
+      file = 0;
+    } else if ('1' <= c && c <= '8') {
+      if (file + (c - '0') > 8)
+        return FenBadPieces;
+      for (int i = 0; i < c - '0'; ++i, ++file)
+        new_pieces[square++] = InvalidPiece;
+    } else {
+      const piece_t piece = char_to_piece(c);
+      if (piece == InvalidPiece || file == 8)
+        return FenBadPieces;
+      // pawns can never stand on the first or last rank
+      if (piece_type(piece) == Pawn && (square < 8 || square >= 56))
+        return FenBadPieces;
+      new_pieces[square++] = piece;
+      file++;
+    }
+  }
+  if (square != 64 || file != 8)
+    return FenBadPieces;
+  int white_kings = 0, black_kings = 0;
+  for (const piece_t piece : new_pieces) {
+    white_kings += piece == WhiteKing;
+    black_kings += piece == BlackKing;
+  }
+  if (white_kings != 1 || black_kings != 1)
+    return FenBadKings;
+
+  if (side_field != "w" && side_field != "b")
+    return FenBadSide;
+  const colour_t new_side_to_move = side_field == "w" ? White : Black;
+
+  // the side not to move can't be in check, or its king could be taken. This
+  // is is_square_attacked on the new pieces, since the board isn't set yet.
+  bitboard_t new_piece_bb[16] = {};
+  bitboard_t new_occupied = 0;
+  for (square_t sq = 0; sq < 64; ++sq) {
+    if (new_pieces[sq] != InvalidPiece) {
+      new_piece_bb[new_pieces[sq]] |= square_bb(sq);
+      new_occupied |= square_bb(sq);
+    }
+  }
+  const square_t their_king =
+      lsb(new_piece_bb[make_piece(-new_side_to_move, King)]);
+  if (new_side_to_move == White
+          ? attacked_by<White>(their_king, new_piece_bb, new_occupied)
+          : attacked_by<Black>(their_king, new_piece_bb, new_occupied))
+    return FenOpponentInCheck;
+
+  int new_castle_perms = 0;
+  if (castle_field != "-") {
+    if (castle_field.empty())
+      return FenBadCastling;
+    for (const char c : castle_field) {
+      switch (c) {
+      case 'K':
+        new_castle_perms |= WhiteShort;
+        break;
+      case 'Q':
+        new_castle_perms |= WhiteLong;
+        break;
+      case 'k':
+        new_castle_perms |= BlackShort;
+        break;
+      case 'q':
+        new_castle_perms |= BlackLong;
+        break;
+      default:
+        return FenBadCastling;
       }
-    } else if (c != '/') {
-      pieces[square++] = char_to_piece(c);
     }
   }
+  // each right needs the king and the rook still on their starting squares
+  if (((new_castle_perms & (WhiteShort | WhiteLong)) &&
+       new_pieces[E1] != WhiteKing) ||
+      ((new_castle_perms & WhiteShort) && new_pieces[H1] != WhiteRook) ||
+      ((new_castle_perms & WhiteLong) && new_pieces[A1] != WhiteRook) ||
+      ((new_castle_perms & (BlackShort | BlackLong)) &&
+       new_pieces[E8] != BlackKing) ||
+      ((new_castle_perms & BlackShort) && new_pieces[H8] != BlackRook) ||
+      ((new_castle_perms & BlackLong) && new_pieces[A8] != BlackRook))
+    return FenBadCastling;
 
-  side_to_move = side_to_move_str == "w" ? White : Black;
+  square_t new_en_passant = InvalidSquare;
+  if (en_passant_field != "-") {
+    // the square behind a pawn of the side that just moved
+    const char en_passant_rank = new_side_to_move == White ? '6' : '3';
+    if (en_passant_field.size() != 2 || en_passant_field[0] < 'a' ||
+        en_passant_field[0] > 'h' || en_passant_field[1] != en_passant_rank)
+      return FenBadEnPassant;
+    new_en_passant = square_from_file_rank(en_passant_field[0] - 'a',
+                                           en_passant_field[1] - '1');
+    // the pawn stands in front of the square, which it and the square it
+    // started from were just left empty by the double push
+    const piece_t pushed_pawn = make_piece(-new_side_to_move, Pawn);
+    if (new_pieces[get_en_passant_capture(new_en_passant, new_side_to_move)] !=
+            pushed_pawn ||
+        new_pieces[new_en_passant] != InvalidPiece ||
+        new_pieces[new_en_passant - 8 * new_side_to_move] != InvalidPiece)
+      return FenBadEnPassant;
+  }
 
-  castle_perms = 0;
-  for (const char c : castle_perms_str) {
-    switch (c) {
-    case 'K':
-      castle_perms |= WhiteShort;
-      break;
-    case 'Q':
-      castle_perms |= WhiteLong;
-      break;
-    case 'k':
-      castle_perms |= BlackShort;
-      break;
-    case 'q':
-      castle_perms |= BlackLong;
-      break;
-    default:
-      break;
+  // the counters are optional, since EPD leaves them out: anything after them
+  // is ignored, as are EPD operations in their place, whose opcodes start
+  // with a letter. Anything else there is a bad counter.
+  int new_fifty_move = 0, new_full_move = 1;
+  std::string_view counter_field = next_field(rest);
+  const bool epd_operation =
+      !counter_field.empty() &&
+      std::isalpha(static_cast<unsigned char>(counter_field[0]));
+  if (!counter_field.empty() && !epd_operation) {
+    if (!parse_counter(counter_field, new_fifty_move))
+      return FenBadCounters;
+    counter_field = next_field(rest);
+    if (!counter_field.empty() && !parse_counter(counter_field, new_full_move))
+      return FenBadCounters;
+  }
+
+  set_position(new_pieces, new_side_to_move, new_castle_perms, new_en_passant,
+               new_fifty_move, new_full_move);
+  return FenOk;
+}
+
+PackedPosition Board::pack() const {
+  PackedPosition position;
+  for (square_t sq = 0; sq < 64; sq += 2)
+    position.pieces[sq / 2] = pieces[sq] | pieces[sq + 1] << 4;
+  position.full_move = full_move;
+  position.fifty_move = fifty_move;
+  position.side_to_move = side_to_move;
+  position.castle_perms = castle_perms;
+  position.en_passant = en_passant;
+  return position;
+}
+
+void Board::set_packed(const PackedPosition &position) {
+  piece_t new_pieces[64];
+  for (square_t sq = 0; sq < 64; sq += 2) {
+    new_pieces[sq] = position.pieces[sq / 2] & 15;
+    new_pieces[sq + 1] = position.pieces[sq / 2] >> 4;
+  }
+  set_position(new_pieces, position.side_to_move, position.castle_perms,
+               position.en_passant, position.fifty_move, position.full_move);
+}
+
+void Board::set_position(const piece_t (&new_pieces)[64],
+                         const colour_t new_side_to_move,
+                         const int new_castle_perms,
+                         const square_t new_en_passant,
+                         const int new_fifty_move, const int new_full_move) {
+  for (square_t sq = 0; sq < 64; ++sq)
+    pieces[sq] = InvalidPiece;
+  for (bitboard_t &bb : piece_bb)
+    bb = 0;
+  colour_bb[0] = colour_bb[1] = occupied = 0;
+  hash = pawn_hash = 0;
+  psqt = Score{};
+  phase = 0;
+  dirty_count = 0;
+  for (square_t sq = 0; sq < 64; ++sq) {
+    if (new_pieces[sq] != InvalidPiece)
+      add_piece(sq, new_pieces[sq]);
+    // the accumulator is refreshed below rather than updated piece by piece
+    dirty_count = 0;
+  }
+
+  side_to_move = new_side_to_move;
+  castle_perms = new_castle_perms;
+  en_passant = new_en_passant;
+  fifty_move = new_fifty_move;
+  full_move = new_full_move;
+  history_ply = 0;
+
+  // the pieces were hashed as they were added
+  if (side_to_move == Black)
+    hash ^= zobrist_keys.side;
+  hash ^= zobrist_keys.castle_perms[castle_perms];
+  if (en_passant_capturable())
+    hash ^= zobrist_keys.en_passant_file[square_file(en_passant)];
+  assert(hash == compute_hash() && pawn_hash == compute_pawn_hash());
+  assert(psqt == compute_psqt() && phase == compute_phase());
+  accumulator_generation = 0;
+  update_accumulator();
+}
+
+uint64_t Board::compute_hash() const {
+  uint64_t result = 0;
+  bitboard_t occupied_copy = occupied;
+  while (occupied_copy) {
+    const square_t sq = pop_lsb(occupied_copy);
+    result ^= zobrist_keys.pieces[pieces[sq]][sq];
+  }
+  if (side_to_move == Black)
+    result ^= zobrist_keys.side;
+  result ^= zobrist_keys.castle_perms[castle_perms];
+  if (en_passant_capturable())
+    result ^= zobrist_keys.en_passant_file[square_file(en_passant)];
+  return result;
+}
+
+uint64_t Board::compute_pawn_hash() const {
+  uint64_t result = 0;
+  for (const piece_t piece : {WhitePawn, BlackPawn}) {
+    bitboard_t pawns = piece_bb[piece];
+    while (pawns) {
+      const square_t sq = pop_lsb(pawns);
+      result ^= zobrist_keys.pieces[piece][sq];
     }
   }
+  return result;
+}
 
-  en_passant = string_to_square(en_passant_str);
-  fifty_move = stoi(fifty_move_str);
-  full_move = stoi(full_move_str);
+Score Board::compute_psqt() const {
+  Score result;
+  bitboard_t occupied_copy = occupied;
+  while (occupied_copy) {
+    const square_t sq = pop_lsb(occupied_copy);
+    result += psqt_table.scores[pieces[sq]][sq];
+  }
+  return result;
+}
+
+int Board::compute_phase() const {
+  int result = 0;
+  for (const piece_t piece : pieces) {
+    if (piece != InvalidPiece)
+      result += psqt_table.phases[piece];
+  }
+  return result;
+}
+
+int Board::static_evaluation(PawnHashTable &pawn_table) const {
+  const PawnEntry &pawns = pawn_table.probe(*this);
+  Score score = psqt + pawns.score + pawns.shield[0] + pawns.shield[1];
+  for (const std::unique_ptr<EvalTerm> &term : get_eval_terms())
+    score += term->evaluate(*this);
+  return taper(score, phase);
+}
+
+int Board::nnue_evaluation() const {
+  assert(nnue_network.is_loaded());
+  int score;
+  if (accumulator_generation == nnue_network.get_generation()) {
+#ifndef NDEBUG
+    Accumulator fresh;
+    refresh_accumulator(fresh);
+    assert(std::memcmp(&fresh, &accumulator, sizeof(Accumulator)) == 0);
+#endif
+    score = nnue_network.evaluate(accumulator, side_to_move);
+  } else {
+    // the network was loaded after this position was last changed
+    Accumulator fresh;
+    refresh_accumulator(fresh);
+    score = nnue_network.evaluate(fresh, side_to_move);
+  }
+  return side_to_move == White ? score : -score;
+}
+
+GameResult Board::get_game_state() const {
+  if (generate_legal_moves().size() == 0) {
+    if (!in_check())
+      return Stalemate;
+    return side_to_move == White ? BlackCheckmate : WhiteCheckmate;
+  }
+  if (fifty_move >= 100)
+    return FiftyMoveRule;
+  if (is_repetition(0))
+    return Threefold;
+  if (is_insufficient_material())
+    return InsufficientMaterial;
+  return NotOver;
+}
+
+void Board::forget_history() {
+  const int keep = std::min({fifty_move, history_ply, 100});
+  std::memmove(history, history + history_ply - keep,
+               keep * sizeof(StateInfo));
+  history_ply = keep;
+}
+
+bool Board::is_draw(const int ply) const {
+  return fifty_move >= 100 || is_repetition(ply) ||
+         is_insufficient_material();
+}
+
+bool Board::is_repetition(const int ply) const {
+  // a capture or pawn move can't be undone, so the position can only have
+  // occurred since the last one; and it needs the same side to move, at
+  // least four plies ago
+  const int end = std::min(fifty_move, history_ply);
+  bool seen_before_root = false;
+  for (int i = 4; i <= end; i += 2) {
+    if (history[history_ply - i].hash != hash)
+      continue;
+    if (i <= ply || seen_before_root)
+      return true;
+    seen_before_root = true;
+  }
+  return false;
+}
+
+bool Board::is_insufficient_material() const {
+  if (piece_bb[WhitePawn] | piece_bb[BlackPawn] | piece_bb[WhiteRook] |
+      piece_bb[BlackRook] | piece_bb[WhiteQueen] | piece_bb[BlackQueen])
+    return false;
+  const bitboard_t bishops = piece_bb[WhiteBishop] | piece_bb[BlackBishop];
+  const int minors = get_piece_count(WhiteKnight) +
+                     get_piece_count(BlackKnight) + popcount(bishops);
+  if (minors <= 1)
+    return true;
+  // bishops of a single square colour can never attack the other colour
+  return !(piece_bb[WhiteKnight] | piece_bb[BlackKnight]) &&
+         (!(bishops & dark_squares_bb) || !(bishops & ~dark_squares_bb));
+}
+
+void Board::refresh_accumulator(Accumulator &target) const {
+  nnue_network.refresh(target, White, pieces);
+  nnue_network.refresh(target, Black, pieces);
+}
+
+void Board::update_accumulator() {
+  const int count = dirty_count;
+  dirty_count = 0;
+  if (!nnue_network.is_loaded())
+    return;
+  if (accumulator_generation != nnue_network.get_generation()) {
+    refresh_accumulator(accumulator);
+    accumulator_generation = nnue_network.get_generation();
+    return;
+  }
+
+  for (const colour_t perspective : {White, Black}) {
+    const piece_t king = make_piece(perspective, King);
+    // every feature is relative to the king, so a king move starts afresh
+    if (std::any_of(dirty_pieces, dirty_pieces + count,
+                    [&](const DirtyPiece &dirty) {
+                      return dirty.piece == king;
+                    })) {
+      nnue_network.refresh(accumulator, perspective, pieces);
+      continue;
+    }
+    const square_t king_sq = lsb(piece_bb[king]);
+    for (int i = 0; i < count; ++i) {
+      const DirtyPiece &dirty = dirty_pieces[i];
+      // the other king is not an input
+      if (piece_type(dirty.piece) == King)
+        continue;
+      if (dirty.from != InvalidSquare)
+        nnue_network.remove_feature(
+            accumulator, perspective,
+            Network::feature_index(perspective, king_sq, dirty.piece,
+                                   dirty.from));
+      if (dirty.to != InvalidSquare)
+        nnue_network.add_feature(accumulator, perspective,
+                                 Network::feature_index(perspective, king_sq,
+                                                        dirty.piece, dirty.to));
+    }
+  }
 }
 
 std::string Board::to_fen() const {
@@ -130,344 +566,256 @@ void Board::print_board() const {
 
 // Is the given square attacked by the given side?
 bool Board::is_square_attacked(const square_t sq, const colour_t side) const {
-  if (piece_colour(pieces[sq]) == side)
-    return false;
+  return side == White ? is_attacked_by<White>(sq) : is_attacked_by<Black>(sq);
+}
 
-  const int file = square_file(sq);
-  const int rank = square_rank(sq);
+template <Colour By> bool Board::is_attacked_by(const square_t sq) const {
+  return attacked_by<By>(sq, piece_bb, occupied);
+}
 
-  // Pawns
-  const int capture_left = side == White ? 7 : -9;
-  const int capture_right = side == White ? 9 : -7;
-  const piece_t side_pawn = side == White ? WhitePawn : BlackPawn;
+bitboard_t Board::attackers_to(const square_t sq,
+                              const bitboard_t occupancy) const {
+  const bitboard_t rooks_queens = piece_bb[WhiteRook] | piece_bb[BlackRook] |
+                                  piece_bb[WhiteQueen] | piece_bb[BlackQueen];
+  const bitboard_t bishops_queens =
+      piece_bb[WhiteBishop] | piece_bb[BlackBishop] | piece_bb[WhiteQueen] |
+      piece_bb[BlackQueen];
+  return (pawn_attackers_bb(sq, White) & piece_bb[WhitePawn]) |
+         (pawn_attackers_bb(sq, Black) & piece_bb[BlackPawn]) |
+         (knight_attacks_bb(sq) &
+          (piece_bb[WhiteKnight] | piece_bb[BlackKnight])) |
+         (king_attacks_bb(sq) & (piece_bb[WhiteKing] | piece_bb[BlackKing])) |
+         (rook_attacks(sq, occupancy) & rooks_queens) |
+         (bishop_attacks(sq, occupancy) & bishops_queens);
+}
 
-  // TODO: Check if these are correct
-  if (file > 0 && 0 <= sq + capture_left && sq + capture_left < 64 &&
-      pieces[sq + capture_left] == side_pawn) {
-    return true;
-  }
-  if (file < 7 && 0 <= sq + capture_right && sq + capture_right < 64 &&
-      pieces[sq + capture_right] == side_pawn) {
+bool Board::see_ge(const PackedMove move, const int threshold) const {
+  const MoveType type = move.type();
+  if (type != Quiet && type != Capture && type != DoublePawn)
+    return 0 >= threshold;
+
+  const square_t from = move.from(), to = move.to();
+  // what we are up after the capture, if it isn't recaptured
+  int swap = (pieces[to] == InvalidPiece ? 0
+                                         : see_values[piece_type(pieces[to])]) -
+             threshold;
+  if (swap < 0)
+    return false;
+  // and after the recapture: if we still hold threshold, we're done
+  swap = see_values[piece_type(pieces[from])] - swap;
+  if (swap <= 0)
     return true;
-  }
 
-  // Knights
-  const piece_t side_knight = side == White ? WhiteKnight : BlackKnight;
-  const static std::array<std::pair<int, int>, 8> knight_offsets = {
-      std::make_pair(1, 2),   std::make_pair(2, 1),  std::make_pair(-1, -2),
-      std::make_pair(-2, -1), std::make_pair(1, -2), std::make_pair(-1, 2),
-      std::make_pair(-2, 1),  std::make_pair(2, -1)};
-  for (const auto &[dx, dy] : knight_offsets) {
-    const int new_file = file + dx;
-    const int new_rank = rank + dy;
-    if (0 <= new_file && new_file <= 7 && 0 <= new_rank && new_rank <= 7) {
-      const int target_sq = square_from_file_rank(new_file, new_rank);
-      if (pieces[target_sq] == side_knight)
-        return true;
-    }
-  }
+  const bitboard_t bishops_queens =
+      piece_bb[WhiteBishop] | piece_bb[BlackBishop] | piece_bb[WhiteQueen] |
+      piece_bb[BlackQueen];
+  const bitboard_t rooks_queens = piece_bb[WhiteRook] | piece_bb[BlackRook] |
+                                  piece_bb[WhiteQueen] | piece_bb[BlackQueen];
+  bitboard_t occupancy = occupied ^ square_bb(from) ^ square_bb(to);
+  bitboard_t attackers = attackers_to(to, occupancy);
+  colour_t side = piece_colour(pieces[from]);
+  // whether the side that made the move comes out ahead so far
+  bool result = true;
 
-  // King
-  const piece_t side_king = side == White ? WhiteKing : BlackKing;
-  const static std::array<std::pair<int, int>, 4> diagonal_offsets = {
-      std::make_pair(-1, 1), std::make_pair(-1, -1), std::make_pair(1, -1),
-      std::make_pair(1, 1)};
-  const static std::array<std::pair<int, int>, 4> ortho_offsets = {
-      std::make_pair(-1, 0), std::make_pair(1, 0), std::make_pair(0, -1),
-      std::make_pair(0, 1)};
-
-  for (const auto &[dx, dy] : diagonal_offsets) {
-    const int new_file = file + dx;
-    const int new_rank = rank + dy;
-    if (0 <= new_file && new_file <= 7 && 0 <= new_rank && new_rank <= 7) {
-      const int target_sq = square_from_file_rank(new_file, new_rank);
-      if (pieces[target_sq] == side_king)
-        return true;
-    }
-  }
+  while (true) {
+    side = -side;
+    attackers &= occupancy;
+    const bitboard_t side_attackers = attackers & get_colour_bb(side);
+    if (!side_attackers)
+      break;
+    result = !result;
 
-  for (const auto &[dx, dy] : ortho_offsets) {
-    const int new_file = file + dx;
-    const int new_rank = rank + dy;
-    if (0 <= new_file && new_file <= 7 && 0 <= new_rank && new_rank <= 7) {
-      const int target_sq = square_from_file_rank(new_file, new_rank);
-      if (pieces[target_sq] == side_king)
-        return true;
-    }
+    // recapture with the least valuable attacker
+    int type = Pawn;
+    bitboard_t attacker_bb;
+    while (!(attacker_bb = side_attackers & piece_bb[make_piece(side, type)]))
+      type++;
+    // the king may only recapture if nothing can take it back
+    if (type == King)
+      return (attackers & ~get_colour_bb(side)) ? !result : result;
+    // swap is what the side to capture stands to lose: if it can't get back
+    // above it, it stops here
+    swap = see_values[type] - swap;
+    if (swap < result)
+      break;
+
+    // taking the attacker away may uncover a slider behind it
+    occupancy ^= square_bb(lsb(attacker_bb));
+    if (type == Pawn || type == Bishop || type == Queen)
+      attackers |= bishop_attacks(to, occupancy) & bishops_queens;
+    if (type == Rook || type == Queen)
+      attackers |= rook_attacks(to, occupancy) & rooks_queens;
   }
+  return result;
+}
 
-  // Slidey ortho pieces
-  const piece_t side_bishop = side == White ? WhiteBishop : BlackBishop;
-  const piece_t side_rook = side == White ? WhiteRook : BlackRook;
-  const piece_t side_queen = side == White ? WhiteQueen : BlackQueen;
+bitboard_t Board::get_checkers() const {
+  return attackers_to(get_king_square(side_to_move), occupied) &
+         get_colour_bb(-side_to_move);
+}
 
-  for (const auto &[dx, dy] : ortho_offsets) {
-    int cur_file = file + dx, cur_rank = rank + dy;
-    while (true) {
-      if (!(0 <= cur_file && cur_file <= 7 && 0 <= cur_rank && cur_rank <= 7))
-        break;
-      const int target_sq = square_from_file_rank(cur_file, cur_rank);
-      const piece_t target_piece = pieces[target_sq];
-      if (piece_colour(target_piece) == side &&
-          (target_piece == side_rook || target_piece == side_queen)) {
-        return true;
-      } else if (target_piece == InvalidPiece) {
-        cur_file += dx;
-        cur_rank += dy;
-      } else { // Encountered own coloured piece
-        break;
-      }
-    }
-  }
+bitboard_t Board::get_pinned(const colour_t side) const {
+  const square_t king_sq = get_king_square(side);
+  const colour_t enemy = -side;
+  // enemy sliders that would attack the king on an empty board
+  bitboard_t snipers =
+      (rook_attacks(king_sq, 0) & (get_piece_bb(make_piece(enemy, Rook)) |
+                                   get_piece_bb(make_piece(enemy, Queen)))) |
+      (bishop_attacks(king_sq, 0) & (get_piece_bb(make_piece(enemy, Bishop)) |
+                                     get_piece_bb(make_piece(enemy, Queen))));
 
-  // Slidey diagonal pieces
-  for (const auto &[dx, dy] : diagonal_offsets) {
-    int cur_file = file + dx, cur_rank = rank + dy;
-    while (true) {
-      if (!(0 <= cur_file && cur_file <= 7 && 0 <= cur_rank && cur_rank <= 7))
-        break;
-      const int target_sq = square_from_file_rank(cur_file, cur_rank);
-      const piece_t target_piece = pieces[target_sq];
-      if (piece_colour(target_piece) == side &&
-          (target_piece == side_bishop || target_piece == side_queen)) {
-        return true;
-      } else if (target_piece == InvalidPiece) {
-        cur_file += dx;
-        cur_rank += dy;
-      } else { // Encountered own coloured piece
-        break;
-      }
-    }
+  bitboard_t pinned = 0;
+  while (snipers) {
+    const bitboard_t blockers =
+        between_bb(king_sq, pop_lsb(snipers)) & occupied;
+    if (blockers && !(blockers & (blockers - 1)))
+      pinned |= blockers & get_colour_bb(side);
   }
+  return pinned;
+}
 
-  return false;
+bool Board::is_legal_en_passant(const square_t from) const {
+  const square_t king_sq = get_king_square(side_to_move);
+  const square_t captured = get_en_passant_capture(en_passant, side_to_move);
+  const bitboard_t after = (occupied ^ square_bb(from) ^ square_bb(captured)) |
+                           square_bb(en_passant);
+  const colour_t enemy = -side_to_move;
+  const bitboard_t enemy_queens = get_piece_bb(make_piece(enemy, Queen));
+
+  // a pawn or knight check stays unless the captured pawn was the checker;
+  // slider checks are covered by the ray test below
+  const bitboard_t leapers = get_piece_bb(make_piece(enemy, Pawn)) |
+                             get_piece_bb(make_piece(enemy, Knight));
+  if (get_checkers() & leapers & ~square_bb(captured))
+    return false;
+  return !(rook_attacks(king_sq, after) &
+           (get_piece_bb(make_piece(enemy, Rook)) | enemy_queens)) &&
+         !(bishop_attacks(king_sq, after) &
+           (get_piece_bb(make_piece(enemy, Bishop)) | enemy_queens));
 }
 
-void Board::get_pawn_moves(std::vector<Move> &move_list,
-                           const square_t location) const {
-  // Find start rank and end rank
-  const piece_t pawn = pieces[location];
-  const colour_t colour = piece_colour(pawn);
-  const int start_rank = colour == White ? 1 : 6;
-  const int last_rank = colour == White ? 6 : 1;
+template <GenType Type, Colour Us>
+void Board::get_pawn_moves(MoveList &move_list, const square_t location,
+                           const bitboard_t targets) const {
+  using Side = ColourTraits<Us>;
+  constexpr int forward = Side::forward;
   const int this_rank = square_rank(location);
-  const int this_file = square_file(location);
-  const int forward = colour == White ? -8 : 8;
-  const int capture_left = colour == White ? -9 : 7;
-  const int capture_right = colour == White ? -7 : 9;
-  const colour_t opposite_colour = -side_to_move;
-  const piece_t opposite_king = side_to_move == White ? BlackKing : WhiteKing;
-  assert(piece_colour(pawn) == side_to_move);
-
-  if (this_rank == start_rank) {
+  assert(pieces[location] == Side::pawn && side_to_move == Us);
+
+  // Captures takes every promotion, pushes included, and Quiets none
+  constexpr bool gen_captures = Type != Quiets;
+  constexpr bool gen_quiets = Type != Captures;
+  const bitboard_t captures =
+      gen_captures ? get_colour_bb(Side::them) & targets : 0;
+  const bitboard_t pushes = ~occupied & targets;
+  const bitboard_t attacks = pawn_attacks_bb(location, Us);
+  bitboard_t capture_targets = attacks & captures;
+
+  if (gen_quiets && this_rank == Side::start_rank) {
     // 2 squares forward
     if (pieces[location + forward] == InvalidPiece &&
-        pieces[location + 2 * forward] == InvalidPiece)
-      move_list.emplace_back(location, location + 2 * forward, DoublePawn,
-                             InvalidPiece, InvalidPiece);
+        (pushes & square_bb(location + 2 * forward)))
+      move_list.emplace_back(location, location + 2 * forward, DoublePawn);
   }
-  if (this_rank != last_rank) {
+  if (this_rank != Side::last_rank) {
     // 1 square up
-    if (pieces[location + forward] == InvalidPiece)
-      move_list.emplace_back(location, location + forward, Quiet, InvalidPiece,
-                             InvalidPiece);
-    if (this_file > 0) {
-      // Capture left
-      if (piece_colour(pieces[location + capture_left]) == opposite_colour)
-        move_list.emplace_back(location, location + capture_left, Capture,
-                               InvalidPiece, pieces[location + capture_left]);
-      if (location + capture_left == en_passant)
-        move_list.emplace_back(location, en_passant, EnPassant, InvalidPiece,
-                               pieces[location - 1]);
-    }
-    if (this_file < 7) {
-      // Capture right
-      if (piece_colour(pieces[location + capture_right]) == opposite_colour)
-        move_list.emplace_back(location, location + capture_left, Capture,
-                               InvalidPiece, pieces[location + capture_right]);
-      if (location + capture_right == en_passant)
-        move_list.emplace_back(location, en_passant, EnPassant, InvalidPiece,
-                               pieces[location + 1]);
-    }
-  } else {
-    const piece_t my_knight = side_to_move == White ? WhiteKnight : BlackKnight;
-    const piece_t my_bishop = side_to_move == White ? WhiteBishop : BlackBishop;
-    const piece_t my_rook = side_to_move == White ? WhiteRook : BlackRook;
-    const piece_t /* oh no */ my_queen =
-        side_to_move == White ? WhiteQueen : BlackQueen;
-
-    // Promotions
-    if (pieces[location + forward] == InvalidPiece) {
-      move_list.emplace_back(location, location + forward, Promotion, my_knight,
-                             InvalidPiece);
-      move_list.emplace_back(location, location + forward, Promotion, my_bishop,
-                             InvalidPiece);
-      move_list.emplace_back(location, location + forward, Promotion, my_rook,
-                             InvalidPiece);
-      move_list.emplace_back(location, location + forward, Promotion, my_queen,
-                             InvalidPiece);
-    }
-    // Capture promotions
-    if (this_file > 0 &&
-        piece_colour(pieces[location + capture_left]) == opposite_colour &&
-        pieces[location + capture_left] == opposite_king) {
-      move_list.emplace_back(location, location + capture_left, CapturePromote,
-                             my_knight, pieces[location + capture_left]);
-      move_list.emplace_back(location, location + capture_left, CapturePromote,
-                             my_bishop, pieces[location + capture_left]);
-      move_list.emplace_back(location, location + capture_left, CapturePromote,
-                             my_rook, pieces[location + capture_left]);
-      move_list.emplace_back(location, location + capture_left, CapturePromote,
-                             my_queen, pieces[location + capture_left]);
+    if (gen_quiets && (pushes & square_bb(location + forward)))
+      move_list.emplace_back(location, location + forward, Quiet);
+    while (capture_targets)
+      move_list.emplace_back(location, pop_lsb(capture_targets), Capture);
+
+    // En passant
+    if (gen_captures && en_passant != InvalidSquare &&
+        (attacks & square_bb(en_passant)) &&
+        ((Type != Legal && Type != Evasions) ||
+         is_legal_en_passant(location)))
+      move_list.emplace_back(location, en_passant, EnPassant);
+  } else if (gen_captures) {
+    // Promotions, and capture promotions
+    if (pushes & square_bb(location + forward)) {
+      for (int type = Knight; type <= Queen; ++type)
+        move_list.emplace_back(location, location + forward, Promotion, type);
     }
-    if (this_file < 7 &&
-        piece_colour(pieces[location + capture_right]) == opposite_colour &&
-        pieces[location + capture_right] == opposite_king) {
-      move_list.emplace_back(location, location + capture_right, CapturePromote,
-                             my_knight, pieces[location + capture_right]);
-      move_list.emplace_back(location, location + capture_right, CapturePromote,
-                             my_bishop, pieces[location + capture_right]);
-      move_list.emplace_back(location, location + capture_right, CapturePromote,
-                             my_rook, pieces[location + capture_right]);
-      move_list.emplace_back(location, location + capture_right, CapturePromote,
-                             my_queen, pieces[location + capture_right]);
+    while (capture_targets) {
+      const square_t to = pop_lsb(capture_targets);
+      for (int type = Knight; type <= Queen; ++type)
+        move_list.emplace_back(location, to, CapturePromote, type);
     }
   }
 }
 
-void Board::get_knight_moves(std::vector<Move> &move_list,
-                             const square_t location) const {
-  const int file = square_file(location);
-  const int rank = square_rank(location);
-  const static std::array<std::pair<int, int>, 8> knight_offsets = {
-      std::make_pair(1, 2),   std::make_pair(2, 1),  std::make_pair(-1, -2),
-      std::make_pair(-2, -1), std::make_pair(1, -2), std::make_pair(-1, 2),
-      std::make_pair(-2, 1),  std::make_pair(2, -1)};
-  for (const auto &[dx, dy] : knight_offsets) {
-    const int new_file = file + dx;
-    const int new_rank = rank + dy;
-    if (0 <= new_file && new_file <= 7 && 0 <= new_rank && new_rank <= 7) {
-      const square_t to_square = square_from_file_rank(new_file, new_rank);
-      const piece_t to_piece = pieces[to_square];
-      if (to_piece == InvalidPiece) {
-        move_list.emplace_back(location, to_square, Quiet, InvalidPiece,
-                               InvalidPiece);
-      } else if (piece_colour(to_piece) != side_to_move) {
-        move_list.emplace_back(location, to_square, Capture, InvalidPiece,
-                               to_piece);
-      }
-    }
-  }
+void Board::get_knight_moves(MoveList &move_list, const square_t location,
+                             const bitboard_t targets) const {
+  get_target_moves(move_list, location, knight_attacks_bb(location) & targets);
 }
 
-void Board::get_slide_move_helper(std::vector<Move> &move_list,
-                                  const square_t location, const int dx,
-                                  const int dy) const {
-  const int file = square_file(location);
-  const int rank = square_rank(location);
-
-  int new_dx = dx;
-  int new_dy = dy;
-  while (true) {
-    const int new_file = file + new_dx;
-    const int new_rank = rank + new_dy;
-    if (new_file < 0 || new_file >= 8 || new_rank < 0 || new_rank >= 8)
-      break;
-
-    const square_t target = square_from_file_rank(new_file, new_rank);
+void Board::get_target_moves(MoveList &move_list,
+                             const square_t location,
+                             bitboard_t targets) const {
+  while (targets) {
+    const square_t target = pop_lsb(targets);
     const piece_t target_piece = pieces[target];
     if (target_piece == InvalidPiece) {
-      // if its invalid, add to move list
-      move_list.push_back(
-          Move(location, target, Quiet, InvalidPiece, InvalidPiece));
-      new_dx += dx;
-      new_dy += dy;
-    } else if (piece_colour(target_piece) != side_to_move) {
-      move_list.push_back(
-          Move(location, target, Capture, InvalidPiece, target_piece));
-      break;
+      move_list.emplace_back(location, target, Quiet);
     } else {
-      break;
+      move_list.emplace_back(location, target, Capture);
     }
   }
 }
 
-void Board::get_bishop_moves(std::vector<Move> &move_list,
-                             const square_t location) const {
-  get_slide_move_helper(move_list, location, 1, 1);
-  get_slide_move_helper(move_list, location, -1, 1);
-  get_slide_move_helper(move_list, location, 1, -1);
-  get_slide_move_helper(move_list, location, -1, -1);
+void Board::get_bishop_moves(MoveList &move_list, const square_t location,
+                             const bitboard_t targets) const {
+  get_target_moves(move_list, location,
+                   bishop_attacks(location, occupied) & targets);
 }
 
-void Board::get_rook_moves(std::vector<Move> &move_list,
-                           const square_t location) const {
-  get_slide_move_helper(move_list, location, 1, 0);
-  get_slide_move_helper(move_list, location, -1, 0);
-  get_slide_move_helper(move_list, location, 0, 1);
-  get_slide_move_helper(move_list, location, 0, -1);
+void Board::get_rook_moves(MoveList &move_list, const square_t location,
+                           const bitboard_t targets) const {
+  get_target_moves(move_list, location,
+                   rook_attacks(location, occupied) & targets);
 }
 
-void Board::get_queen_moves(std::vector<Move> &move_list,
-                            const square_t location) const {
-  get_bishop_moves(move_list, location);
-  get_rook_moves(move_list, location);
+void Board::get_queen_moves(MoveList &move_list, const square_t location,
+                            const bitboard_t targets) const {
+  get_target_moves(move_list, location,
+                   queen_attacks(location, occupied) & targets);
 }
 
-void Board::get_king_moves(std::vector<Move> &move_list,
+template <GenType Type, Colour Us>
+void Board::get_king_moves(MoveList &move_list,
                            const square_t location) const {
-  const int file = square_file(location);
-  const int rank = square_rank(location);
-  static const std::array<std::pair<int, int>, 8> king_offsets = {
-      std::make_pair(1, 0),  std::make_pair(1, 1),  std::make_pair(1, -1),
-      std::make_pair(0, 1),  std::make_pair(0, -1), std::make_pair(-1, 1),
-      std::make_pair(-1, 0), std::make_pair(-1, -1)};
-
-  for (const auto &[dx, dy] : king_offsets) {
-    const int new_file = file + dx;
-    const int new_rank = rank + dy;
-    if (0 <= new_file && new_file <= 7 && 0 <= new_rank && new_rank <= 7) {
-      const square_t to_square = square_from_file_rank(new_file, new_rank);
-      const piece_t to_piece = pieces[to_square];
-      if (to_piece == InvalidPiece) {
-        move_list.emplace_back(location, to_square, Quiet, InvalidPiece,
-                               InvalidPiece);
-      } else if (piece_colour(to_piece) != side_to_move) {
-        move_list.emplace_back(location, to_square, Capture, InvalidPiece,
-                               to_piece);
-      }
-    }
-  }
+  using Side = ColourTraits<Us>;
+  const bitboard_t enemies = get_colour_bb(Side::them);
+  bitboard_t targets = king_attacks_bb(location) & ~get_colour_bb(Us);
+  if constexpr (Type == Captures)
+    targets &= enemies;
+  else if constexpr (Type == Quiets)
+    targets &= ~occupied;
+  // with the king lifted off the board, so that it can't hide from a slider
+  // behind its own square
+  const bitboard_t without_king = occupied ^ square_bb(location);
 
-  if (side_to_move == White) {
-    if (castle_perms & WhiteShort && (pieces[F1] == InvalidPiece) &&
-        (pieces[G1] == InvalidPiece) && !is_square_attacked(E1, Black) &&
-        !is_square_attacked(F1, Black) && !is_square_attacked(G1, Black)) {
-      move_list.emplace_back(location, G1, ShortCastle, InvalidPiece,
-                             InvalidPiece);
-    }
-    if (castle_perms & WhiteLong && (pieces[B1] == InvalidPiece) &&
-        (pieces[C1] == InvalidPiece) && (pieces[D1] == InvalidPiece) &&
-        !is_square_attacked(E1, Black) && !is_square_attacked(D1, Black) &&
-        !is_square_attacked(C1, Black)) {
-      move_list.emplace_back(location, C1, LongCastle, InvalidPiece,
-                             InvalidPiece);
-    }
-  } else {
-    if (castle_perms & BlackShort && (pieces[F8] == InvalidPiece) &&
-        (pieces[G8] == InvalidPiece) && !is_square_attacked(E8, White) &&
-        !is_square_attacked(F8, White) && !is_square_attacked(G8, White)) {
-      move_list.emplace_back(location, G8, ShortCastle, InvalidPiece,
-                             InvalidPiece);
-    }
-    if (castle_perms & BlackLong && (pieces[B8] == InvalidPiece) &&
-        (pieces[C8] == InvalidPiece) && (pieces[D8] == InvalidPiece) &&
-        !is_square_attacked(E8, White) && !is_square_attacked(D8, White) &&
-        !is_square_attacked(C8, White)) {
-      move_list.emplace_back(location, C8, LongCastle, InvalidPiece,
-                             InvalidPiece);
-    }
+  while (targets) {
+    const square_t to_square = pop_lsb(targets);
+    if ((Type == Legal || Type == Evasions) &&
+        (attackers_to(to_square, without_king) & enemies))
+      continue;
+    move_list.emplace_back(location, to_square,
+                           pieces[to_square] == InvalidPiece ? Quiet : Capture);
   }
+  // there is no castling out of check
+  if (Type == Captures || Type == Evasions)
+    return;
+  if (castle_perms & Side::short_castle && !(occupied & Side::short_empty) &&
+      !is_attacked_by<Side::them>(Side::king_start) &&
+      !is_attacked_by<Side::them>(Side::short_pass) &&
+      !is_attacked_by<Side::them>(Side::short_to))
+    move_list.emplace_back(location, Side::short_to, ShortCastle);
+  if (castle_perms & Side::long_castle && !(occupied & Side::long_empty) &&
+      !is_attacked_by<Side::them>(Side::king_start) &&
+      !is_attacked_by<Side::them>(Side::long_pass) &&
+      !is_attacked_by<Side::them>(Side::long_to))
+    move_list.emplace_back(location, Side::long_to, LongCastle);
 }
 /*
 
@@ -508,125 +856,346 @@ King - S
 
 */
 
-std::vector<Move> Board::generate_pseudo_legal_moves() const {
-  std::vector<Move> result;
-  for (square_t sq = 0; sq < 64; ++sq) {
-    const piece_t piece = pieces[sq];
-    if (piece_colour(piece) != side_to_move)
-      continue;
-    switch (piece) {
-    case WhiteKing:
-    case BlackKing:
-      get_king_moves(result, sq);
-      break;
-    case WhitePawn:
-    case BlackPawn:
-      get_pawn_moves(result, sq);
-      break;
-    case WhiteKnight:
-    case BlackKnight:
-      get_knight_moves(result, sq);
-      break;
-    case WhiteBishop:
-    case BlackBishop:
-      get_bishop_moves(result, sq);
-      break;
-    case WhiteRook:
-    case BlackRook:
-      get_rook_moves(result, sq);
-      break;
-    case WhiteQueen:
-    case BlackQueen:
-      get_queen_moves(result, sq);
-      break;
-    default:
-      __builtin_unreachable();
-    }
+template <GenType Type, Colour Us>
+void Board::get_piece_moves(MoveList &move_list, const square_t location,
+                            const bitboard_t targets) const {
+  // pawns and kings pick out their own captures and quiets
+  bitboard_t piece_targets = targets;
+  if constexpr (Type == Captures)
+    piece_targets &= get_colour_bb(ColourTraits<Us>::them);
+  else if constexpr (Type == Quiets)
+    piece_targets &= ~occupied;
+
+  switch (piece_type(pieces[location])) {
+  case King:
+    get_king_moves<Type, Us>(move_list, location);
+    break;
+  case Pawn:
+    get_pawn_moves<Type, Us>(move_list, location, targets);
+    break;
+  case Knight:
+    get_knight_moves(move_list, location, piece_targets);
+    break;
+  case Bishop:
+    get_bishop_moves(move_list, location, piece_targets);
+    break;
+  case Rook:
+    get_rook_moves(move_list, location, piece_targets);
+    break;
+  case Queen:
+    get_queen_moves(move_list, location, piece_targets);
+    break;
+  default:
+    __builtin_unreachable();
   }
-  return result;
 }
 
-std::vector<Move> Board::generate_legal_moves() const {
-  std::vector<Move> result;
-  Board tmp(*this);
-  const std::vector<Move> pseudo_legal_moves = generate_pseudo_legal_moves();
-  for (const Move move : pseudo_legal_moves) {
-    if (tmp.make_move(move)) {
-      result.push_back(move);
+template <GenType Type> void Board::generate(MoveList &result) const {
+  if (side_to_move == White)
+    generate_moves<Type, White>(result);
+  else
+    generate_moves<Type, Black>(result);
+}
+
+template <GenType Type, Colour Us>
+void Board::generate_moves(MoveList &result) const {
+  const bitboard_t own = get_colour_bb(Us);
+  bitboard_t targets = ~own;
+  bitboard_t pinned = 0;
+  square_t king_sq = InvalidSquare;
+
+  if constexpr (Type == Legal || Type == Evasions) {
+    // work out once which squares can stop a check and which pieces are
+    // pinned, so that every generated move is legal without making it
+    king_sq = lsb(piece_bb[ColourTraits<Us>::king]);
+    const bitboard_t checkers =
+        attackers_to(king_sq, occupied) & get_colour_bb(ColourTraits<Us>::them);
+    assert(Type != Evasions || checkers);
+    if (checkers) {
+      // in double check only the king can move
+      if (checkers & (checkers - 1)) {
+        get_king_moves<Type, Us>(result, king_sq);
+        return;
+      }
+      // otherwise the checker must be captured or blocked
+      targets &= between_bb(king_sq, lsb(checkers)) | checkers;
     }
-    tmp.unmake_move();
+    pinned = get_pinned(Us);
   }
+
+  bitboard_t to_move = own;
+  while (to_move) {
+    const square_t sq = pop_lsb(to_move);
+    // a pinned piece may only move along the line through it and its king
+    get_piece_moves<Type, Us>(result, sq,
+                              (pinned & square_bb(sq))
+                                  ? targets & line_bb(king_sq, sq)
+                                  : targets);
+  }
+}
+
+template void Board::generate<PseudoLegal>(MoveList &result) const;
+template void Board::generate<Legal>(MoveList &result) const;
+template void Board::generate<Captures>(MoveList &result) const;
+template void Board::generate<Quiets>(MoveList &result) const;
+template void Board::generate<Evasions>(MoveList &result) const;
+
+MoveList Board::generate_pseudo_legal_moves() const {
+  MoveList result;
+  generate<PseudoLegal>(result);
+  return result;
+}
+
+MoveList Board::generate_legal_moves() const {
+  MoveList result;
+  generate<Legal>(result);
   return result;
 }
 
+bool Board::is_pseudo_legal(const PackedMove move) const {
+  const square_t from = move.from();
+  if (move == PackedMove::none() || piece_colour(pieces[from]) != side_to_move)
+    return false;
+  // the moves of a single piece are cheap enough to generate and search,
+  // which keeps this in step with the generator by construction
+  MoveList moves;
+  const bitboard_t targets = ~get_colour_bb(side_to_move);
+  if (side_to_move == White)
+    get_piece_moves<PseudoLegal, White>(moves, from, targets);
+  else
+    get_piece_moves<PseudoLegal, Black>(moves, from, targets);
+  for (const PackedMove candidate : moves) {
+    if (candidate == move)
+      return true;
+  }
+  return false;
+}
+
+bool Board::is_legal(const PackedMove move) const {
+  assert(is_pseudo_legal(move));
+  const square_t from = move.from(), to = move.to();
+  const square_t king_sq = get_king_square(side_to_move);
+
+  if (move.type() == EnPassant)
+    return is_legal_en_passant(from);
+  // castling was only generated through unattacked squares
+  if (move.type() == ShortCastle || move.type() == LongCastle)
+    return true;
+  if (from == king_sq)
+    return !(attackers_to(to, occupied ^ square_bb(from)) &
+             get_colour_bb(-side_to_move));
+
+  const bitboard_t checkers = get_checkers();
+  if (checkers) {
+    if (checkers & (checkers - 1))
+      return false;
+    if (!((between_bb(king_sq, lsb(checkers)) | checkers) & square_bb(to)))
+      return false;
+  }
+  return !(get_pinned(side_to_move) & square_bb(from)) ||
+         (line_bb(king_sq, from) & square_bb(to));
+}
+
 square_t Board::get_king_square(const colour_t side) const {
   const piece_t king = side == White ? WhiteKing : BlackKing;
-  for (square_t sq = 0; sq < 64; ++sq) {
-    if (pieces[sq] == king)
-      return sq;
-  }
-  assert(false && "King was not found");
+  assert(piece_bb[king] && "King was not found");
+  return lsb(piece_bb[king]);
 }
 
 // Makes the supplied move on the board: returns true if the resulting position
 // is legal: that is, if the move does not result in being in check.
-bool Board::make_move(const Move move) {
-  switch (move.type) {
+Move Board::unpack_move(const PackedMove move) const {
+  const MoveType type = move.type();
+  const piece_t promotion_piece =
+      move.is_promotion() ? make_piece(side_to_move, move.promotion_type())
+                          : InvalidPiece;
+  piece_t captured_piece = InvalidPiece;
+  if (type == EnPassant)
+    captured_piece = make_piece(-side_to_move, Pawn);
+  else if (move.is_capture())
+    captured_piece = pieces[move.to()];
+  return Move(move.from(), move.to(), type, promotion_piece, captured_piece);
+}
+
+PackedMove Board::parse_uci_move(const std::string &uci) const {
+  for (const PackedMove move : generate_legal_moves()) {
+    if (move.to_uci() == uci)
+      return move;
+  }
+  return PackedMove::none();
+}
+
+namespace {
+
+// castle_perms &= castle_perms_mask[sq] for both squares of a move drops the
+// rights that moving a king or rook off its square (or capturing a rook on
+// its square) gives up
+constexpr std::array<int, 64> make_castle_perms_mask() {
+  std::array<int, 64> mask{};
+  for (square_t sq = 0; sq < 64; ++sq)
+    mask[sq] = WhiteShort | WhiteLong | BlackShort | BlackLong;
+  mask[A1] &= ~WhiteLong;
+  mask[E1] &= ~(WhiteShort | WhiteLong);
+  mask[H1] &= ~WhiteShort;
+  mask[A8] &= ~BlackLong;
+  mask[E8] &= ~(BlackShort | BlackLong);
+  mask[H8] &= ~BlackShort;
+  return mask;
+}
+constexpr std::array<int, 64> castle_perms_mask = make_castle_perms_mask();
+
+} // namespace
+
+bool Board::make_move(const PackedMove move) {
+  return side_to_move == White ? do_make_move<White>(move)
+                               : do_make_move<Black>(move);
+}
+
+void Board::unmake_move() {
+  // the side to move now is the one that didn't make the move
+  if (side_to_move == Black)
+    do_unmake_move<White>();
+  else
+    do_unmake_move<Black>();
+}
+
+template <Colour Us> bool Board::do_make_move(const PackedMove move) {
+  using Side = ColourTraits<Us>;
+  const square_t from = move.from(), to = move.to();
+  const MoveType type = move.type();
+
+  assert(history_ply < max_history && "State history full");
+  StateInfo &state = history[history_ply++];
+  state.hash = hash;
+  state.move = move;
+  state.captured_piece = InvalidPiece;
+  state.castle_perms = castle_perms;
+  state.en_passant = en_passant;
+  state.fifty_move = fifty_move;
+  dirty_count = 0;
+
+  // a pawn move or a capture resets the fifty move counter
+  if (pieces[from] == Side::pawn || move.is_capture())
+    fifty_move = 0;
+  else
+    fifty_move++;
+  if (en_passant != InvalidSquare) {
+    if (en_passant_capturable())
+      hash ^= zobrist_keys.en_passant_file[square_file(en_passant)];
+    en_passant = InvalidSquare;
+  }
+  hash ^= zobrist_keys.castle_perms[castle_perms];
+  castle_perms &= castle_perms_mask[from] & castle_perms_mask[to];
+  hash ^= zobrist_keys.castle_perms[castle_perms];
+
+  switch (type) {
   case Quiet:
-    move_piece(move.from, move.to);
+    move_piece(from, to);
     break;
   case Capture:
-    remove_piece(move.to);
-    move_piece(move.from, move.to);
+    state.captured_piece = pieces[to];
+    remove_piece(to);
+    move_piece(from, to);
     break;
   case Promotion:
-    remove_piece(move.from);
-    add_piece(move.to, move.promotion_piece);
+    remove_piece(from);
+    add_piece(to, make_piece(Us, move.promotion_type()));
     break;
   case CapturePromote:
-    remove_piece(move.from);
-    remove_piece(move.to);
-    add_piece(move.to, move.promotion_piece);
+    state.captured_piece = pieces[to];
+    remove_piece(from);
+    remove_piece(to);
+    add_piece(to, make_piece(Us, move.promotion_type()));
     break;
   case EnPassant:
-    move_piece(move.from, move.to);
-    remove_piece(get_en_passant_capture(en_passant, side_to_move));
-    en_passant = InvalidSquare;
-    break;
-  case LongCastle:
-    if (side_to_move == White) {
-      move_piece(move.from, move.to);
-      move_piece(A1, D1);
-    } else {
-      move_piece(move.from, move.to);
-      move_piece(A8, D8);
-    }
+    state.captured_piece = ColourTraits<Side::them>::pawn;
+    move_piece(from, to);
+    remove_piece(get_en_passant_capture(to, Us));
     break;
   case ShortCastle:
-    if (side_to_move == White) {
-      move_piece(move.from, move.to);
-      move_piece(H1, F1);
-    } else {
-      move_piece(move.from, move.to);
-      move_piece(H8, F8);
-    }
+    move_piece(from, to);
+    move_piece(Side::short_rook_from, Side::short_rook_to);
+    break;
+  case LongCastle:
+    move_piece(from, to);
+    move_piece(Side::long_rook_from, Side::long_rook_to);
     break;
   case DoublePawn:
-    move_piece(move.from, move.to);
-    if (side_to_move == White) {
-      en_passant = move.to + 8;
-    } else {
-      en_passant = move.to - 8;
-    }
+    move_piece(from, to);
+    en_passant = (from + to) / 2;
+    // hashed only if the other side has a pawn to take it with
+    if (pawn_attackers_bb(en_passant, Side::them) &
+        piece_bb[ColourTraits<Side::them>::pawn])
+      hash ^= zobrist_keys.en_passant_file[square_file(en_passant)];
+    break;
   }
-  const colour_t old_side_to_move = side_to_move;
-  const colour_t new_side_to_move = old_side_to_move * -1;
-  side_to_move = new_side_to_move;
+  side_to_move = Side::them;
+  hash ^= zobrist_keys.side;
+  assert(hash == compute_hash() && pawn_hash == compute_pawn_hash());
+  assert(psqt == compute_psqt() && phase == compute_phase());
+  // the search will probe this position next: start fetching its bucket while
+  // the legality check runs
+  tt.prefetch(hash);
 
-  fifty_move++; // TODO: Reset this if a pawn moved or a capture was played
-  if (old_side_to_move == Black)
+  if (Us == Black)
     full_move++;
+  update_accumulator();
+
+  return !is_attacked_by<Side::them>(lsb(piece_bb[Side::king]));
+}
+
+template <Colour Us> void Board::do_unmake_move() {
+  using Side = ColourTraits<Us>;
+  assert(history_ply > 0 && "No move to unmake");
+  const StateInfo &state = history[--history_ply];
+  const PackedMove move = state.move;
+  const square_t from = move.from(), to = move.to();
+  const MoveType type = move.type();
+  dirty_count = 0;
+
+  side_to_move = Us;
+  if (Us == Black)
+    full_move--;
+
+  switch (type) {
+  case Quiet:
+  case DoublePawn:
+    move_piece(to, from);
+    break;
+  case Capture:
+    move_piece(to, from);
+    add_piece(to, state.captured_piece);
+    break;
+  case Promotion:
+    remove_piece(to);
+    add_piece(from, Side::pawn);
+    break;
+  case CapturePromote:
+    remove_piece(to);
+    add_piece(from, Side::pawn);
+    add_piece(to, state.captured_piece);
+    break;
+  case EnPassant:
+    move_piece(to, from);
+    add_piece(get_en_passant_capture(to, Us), state.captured_piece);
+    break;
+  case ShortCastle:
+    move_piece(Side::short_rook_to, Side::short_rook_from);
+    move_piece(to, from);
+    break;
+  case LongCastle:
+    move_piece(Side::long_rook_to, Side::long_rook_from);
+    move_piece(to, from);
+    break;
+  }
 
-  return !is_square_attacked(get_king_square(old_side_to_move),
-                             new_side_to_move);
+  castle_perms = state.castle_perms;
+  en_passant = state.en_passant;
+  fifty_move = state.fifty_move;
+  // the piece moves above already undid their part of the hash, but the
+  // saved key also covers the side, castle perms and en passant file
+  hash = state.hash;
+  assert(hash == compute_hash() && pawn_hash == compute_pawn_hash());
+  assert(psqt == compute_psqt() && phase == compute_phase());
+  update_accumulator();
 }
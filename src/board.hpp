@@ -1,14 +1,20 @@
 
 #pragma once
 
+#include "bitboard.hpp"
 #include "colour.hpp"
 #include "move.hpp"
+#include "nnue.hpp"
+#include "pawns.hpp"
 #include "piece.hpp"
+#include "psqt.hpp"
 #include "square.hpp"
-#include "utils.hpp"
+#include "zobrist.hpp"
 
+#include <cassert>
 #include <iostream>
 #include <string>
+#include <string_view>
 
 // we start with 1111 (15) --> do castleType & cur_state == castleType
 // faster: check castleType & cur_state != 0
@@ -19,6 +25,61 @@ enum CastlePerms {
   BlackLong = 8
 };
 
+// which moves generate() produces
+enum GenType {
+  // every move, without checking whether it leaves the king in check
+  PseudoLegal,
+  // only the moves which do not leave the king in check
+  Legal,
+  // captures and promotions, without checking for check
+  Captures,
+  // moves which are neither captures nor promotions, including castling,
+  // without checking for check
+  Quiets,
+  // the legal moves out of check: only valid while in check
+  Evasions
+};
+
+// why set_fen rejected a FEN
+enum FenError {
+  FenOk = 0,
+  // unknown characters, not 8 ranks of 8 squares, or pawns on a back rank
+  FenBadPieces,
+  // not exactly one king of each colour
+  FenBadKings,
+  FenBadSide,
+  // the side not to move is in check
+  FenOpponentInCheck,
+  // unknown letters, or a right whose king or rook is off its starting square
+  FenBadCastling,
+  // not "-" or a square on the rank behind the pawn that just double pushed,
+  // or no such pawn in front of it
+  FenBadEnPassant,
+  FenBadCounters
+};
+
+constexpr const char *fen_error_message(const FenError error) {
+  switch (error) {
+  case FenOk:
+    return "ok";
+  case FenBadPieces:
+    return "bad piece placement";
+  case FenBadKings:
+    return "need exactly one king per side";
+  case FenBadSide:
+    return "bad side to move";
+  case FenOpponentInCheck:
+    return "the side not to move is in check";
+  case FenBadCastling:
+    return "bad castling rights";
+  case FenBadEnPassant:
+    return "bad en passant square";
+  case FenBadCounters:
+    return "bad move counters";
+  }
+  return "unknown error";
+}
+
 enum GameResult {
   // game is still in progress
   NotOver = 0,
@@ -36,77 +97,323 @@ enum GameResult {
   Draw
 };
 
+// the piece values static exchange evaluation counts in, by PieceType: the
+// king is never captured, so it is worth nothing
+constexpr int see_values[6] = {100, 320, 330, 500, 900, 0};
+
+// everything make_move overwrites that unmake_move cannot work out from the
+// move itself: one entry per move played, kept small so the stack stays cheap
+struct StateInfo {
+  uint64_t hash;
+  PackedMove move;
+  int8_t captured_piece;
+  int8_t castle_perms;
+  int8_t en_passant;
+  int16_t fifty_move;
+};
+
+// A position without the state history and the NNUE accumulator, which
+// make up most of a Board, for keeping many positions at once: Board::pack
+// makes one, and Board::set_packed sets a board up from it again.
+struct PackedPosition {
+  // the piece_t on each square, two to a byte, the lower square in the low
+  // nibble
+  uint8_t pieces[32];
+  int32_t full_move;
+  int16_t fifty_move;
+  int8_t side_to_move;
+  int8_t castle_perms;
+  int8_t en_passant;
+};
+
+// the size of the state history: at most this many moves can be made past
+// the position set_fen set up, or past the last forget_history
+constexpr int max_history = 256;
+
 class Board {
   colour_t side_to_move;
   piece_t pieces[64];
+  // kept in sync with pieces by add_piece/remove_piece/move_piece: piece_bb
+  // is indexed by piece_t, colour_bb by colour_index
+  bitboard_t piece_bb[16];
+  bitboard_t colour_bb[2];
+  bitboard_t occupied;
   int castle_perms;
   square_t en_passant;
   int fifty_move;
   int full_move;
+  // Zobrist key of the position, see zobrist.hpp
+  uint64_t hash;
+  // the part of hash made up by the pawns, which keys the pawn hash table
+  uint64_t pawn_hash;
+  // the material and piece-square score and the game phase, see psqt.hpp
+  Score psqt;
+  int phase;
+
+  // the pieces added, removed and moved by the current make_move or
+  // unmake_move, from which the NNUE accumulator is updated: from or to is
+  // InvalidSquare for a piece added or removed
+  struct DirtyPiece {
+    piece_t piece;
+    square_t from;
+    square_t to;
+  };
+  DirtyPiece dirty_pieces[4];
+  int dirty_count;
+  // the first layer of nnue_network for this position, valid if
+  // accumulator_generation matches the network's
+  Accumulator accumulator;
+  uint32_t accumulator_generation;
+
+  StateInfo history[max_history];
+  // number of moves made since the position was set up
+  int history_ply;
 
 public:
   constexpr static const char *start_fen =
       "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
 public:
-  Board(const std::string &fen = start_fen);
+  // aborts if the FEN is invalid: use set_fen to handle bad input
+  Board(const std::string_view fen = start_fen);
+  // sets up the position of a FEN without allocating. The move counters may
+  // be left out, or replaced by EPD operations, and anything after them is
+  // ignored. On error the board is left unchanged.
+  FenError set_fen(const std::string_view fen);
   std::string to_fen() const;
+  PackedPosition pack() const;
+  // sets up the position pack() made
+  void set_packed(const PackedPosition &position);
+
+  // appends the moves selected by Type to move_list
+  template <GenType Type> void generate(MoveList &move_list) const;
+
+  // whether a move, e.g. from the transposition table or a killer slot, could
+  // have been generated by generate<PseudoLegal> in this position
+  bool is_pseudo_legal(const PackedMove move) const;
+  // whether a pseudo legal move leaves the king safe, without playing it
+  bool is_legal(const PackedMove move) const;
+  // static exchange evaluation: whether the material won by the capture
+  // sequence on the move's target square, with each side recapturing with its
+  // least valuable attacker for as long as that pays, is at least threshold.
+  // Pins are ignored. Castling, en passant and promotions count as even.
+  bool see_ge(const PackedMove move, const int threshold = 0) const;
+  inline bool in_check() const { return get_checkers() != 0; }
 
   // generates all possible moves, not checking whether the king is in check
-  std::vector<Move> generate_pseudo_legal_moves() const;
+  MoveList generate_pseudo_legal_moves() const;
 
   // generates all pseudo legal moves which do not expose the king
   // into check
-  std::vector<Move> generate_legal_moves() const;
+  MoveList generate_legal_moves() const;
 
-  bool make_move(const Move move);
+  // plays a move, pushing what is needed to take it back onto the state
+  // history: returns false if it leaves the mover's king in check (the move
+  // is played regardless and must still be unmade). There must be room for
+  // it: fewer than max_history moves made since the position was set up.
+  bool make_move(const PackedMove move);
+  // takes back the last move made
   void unmake_move();
+  // the moves made since the position was set up, and which can be unmade
+  inline int get_history_ply() const { return history_ply; }
+  // makes room in the state history for a long game: keeps only the moves
+  // since the last capture or pawn move, which are all a repetition can
+  // reach back through (at most 100, since after that the game is drawn)
+  void forget_history();
+
+  // expands a packed move generated in this position, filling in the
+  // captured piece and the colour of the promotion piece
+  Move unpack_move(const PackedMove move) const;
+  // finds the legal move written in UCI notation, or PackedMove::none()
+  PackedMove parse_uci_move(const std::string &uci) const;
 
-  // TODO: evaluates a position for who it favours (white/black)
-  int static_evaluation() const;
+  // evaluates a position for who it favours: positive is good for white.
+  // The piece-square part is kept up to date incrementally and the pawn
+  // structure comes from pawn_table (see pawns.hpp), which only evaluates the
+  // pawns when they have changed, so without extra terms (see eval.hpp) this
+  // is two table lookups.
+  int static_evaluation(PawnHashTable &pawn_table) const;
+  // the evaluation of nnue_network, which must be loaded, positive being good
+  // for white
+  int nnue_evaluation() const;
 
-  // TODO: if the game has ended, how did it end
+  // if the game has ended, how: checkmate, stalemate, the fifty move rule, a
+  // threefold repetition or insufficient material. Generates the legal
+  // moves, so it is meant for the game rather than the search.
   GameResult get_game_state() const;
+  // whether the search should score the position as a draw, ply moves below
+  // its root: by the fifty move rule (ignoring a checkmate on the hundredth
+  // ply), insufficient material, or a repetition. A position seen earlier in
+  // the search counts as drawn the first time it repeats, since the side
+  // which could avoid it then can avoid it now; one from before the root has
+  // to be seen twice. Only compares integers.
+  bool is_draw(const int ply) const;
+  // whether the current position occurred before, as above
+  bool is_repetition(const int ply) const;
+  // whether neither side has the material to checkmate: kings with at most
+  // one minor piece, or only bishops all on squares of one colour
+  bool is_insufficient_material() const;
 
   void print_board() const;
 
   // gets the square the king is on (for checking for checks)
   square_t get_king_square(const colour_t side) const;
   bool is_square_attacked(const square_t sq, const colour_t side) const;
+  // every piece, of either colour, attacking sq given the occupancy
+  bitboard_t attackers_to(const square_t sq, const bitboard_t occupancy) const;
+  // the enemy pieces giving check to the side to move
+  bitboard_t get_checkers() const;
+  // pieces of the given side which are the only thing between their own king
+  // and an enemy slider
+  bitboard_t get_pinned(const colour_t side) const;
 
   // gets the square that a piece has been captured on by en passant
   constexpr static square_t
   get_en_passant_capture(const square_t en_passant,
                          const colour_t side_to_move) {
-    return en_passant - 8 * side_to_move;
+    return en_passant + 8 * side_to_move;
+  }
+
+  inline colour_t get_side_to_move() const { return side_to_move; }
+  // the move that led to this position, or none if no move has been made
+  // since it was set up
+  inline PackedMove get_last_move() const {
+    return history_ply > 0 ? history[history_ply - 1].move
+                           : PackedMove::none();
+  }
+  inline piece_t get_piece(const square_t sq) const { return pieces[sq]; }
+  inline bitboard_t get_piece_bb(const piece_t piece) const {
+    return piece_bb[piece];
+  }
+  inline bitboard_t get_colour_bb(const colour_t side) const {
+    return colour_bb[colour_index(side)];
+  }
+  inline bitboard_t get_occupied() const { return occupied; }
+  inline int get_piece_count(const piece_t piece) const {
+    return popcount(piece_bb[piece]);
   }
+  inline int get_fifty_move() const { return fifty_move; }
+  inline int get_castle_perms() const { return castle_perms; }
+  inline square_t get_en_passant() const { return en_passant; }
+  inline uint64_t get_hash() const { return hash; }
+  inline uint64_t get_pawn_hash() const { return pawn_hash; }
+  inline Score get_psqt() const { return psqt; }
+  inline int get_phase() const { return phase; }
+
+  // the Zobrist key computed from scratch, which the incrementally updated
+  // hash must always equal
+  uint64_t compute_hash() const;
+  uint64_t compute_pawn_hash() const;
+  // likewise for the piece-square score and the phase
+  Score compute_psqt() const;
+  int compute_phase() const;
 
   inline void add_piece(const square_t add, const piece_t piece) {
+    assert(piece != InvalidPiece && pieces[add] == InvalidPiece);
+    const bitboard_t bb = square_bb(add);
     pieces[add] = piece;
+    hash ^= zobrist_keys.pieces[piece][add];
+    if (piece_type(piece) == Pawn)
+      pawn_hash ^= zobrist_keys.pieces[piece][add];
+    add_dirty_piece(piece, InvalidSquare, add);
+    psqt += psqt_table.scores[piece][add];
+    phase += psqt_table.phases[piece];
+    piece_bb[piece] |= bb;
+    colour_bb[colour_index(piece_colour(piece))] |= bb;
+    occupied |= bb;
   }
   inline void remove_piece(const square_t remove) {
+    const piece_t piece = pieces[remove];
+    assert(piece != InvalidPiece);
+    const bitboard_t bb = square_bb(remove);
     pieces[remove] = InvalidPiece;
+    hash ^= zobrist_keys.pieces[piece][remove];
+    if (piece_type(piece) == Pawn)
+      pawn_hash ^= zobrist_keys.pieces[piece][remove];
+    add_dirty_piece(piece, remove, InvalidSquare);
+    psqt -= psqt_table.scores[piece][remove];
+    phase -= psqt_table.phases[piece];
+    piece_bb[piece] ^= bb;
+    colour_bb[colour_index(piece_colour(piece))] ^= bb;
+    occupied ^= bb;
   }
   inline void move_piece(const square_t from, const square_t to) {
     const piece_t piece = pieces[from];
-    remove_piece(from);
-    add_piece(to, piece);
+    assert(piece != InvalidPiece && pieces[to] == InvalidPiece);
+    const bitboard_t bb = square_bb(from) | square_bb(to);
+    pieces[from] = InvalidPiece;
+    pieces[to] = piece;
+    hash ^= zobrist_keys.pieces[piece][from] ^ zobrist_keys.pieces[piece][to];
+    if (piece_type(piece) == Pawn)
+      pawn_hash ^=
+          zobrist_keys.pieces[piece][from] ^ zobrist_keys.pieces[piece][to];
+    add_dirty_piece(piece, from, to);
+    psqt += psqt_table.scores[piece][to] - psqt_table.scores[piece][from];
+    piece_bb[piece] ^= bb;
+    colour_bb[colour_index(piece_colour(piece))] ^= bb;
+    occupied ^= bb;
   }
 
 private:
-  // adds pseudo legal moves to a given move list by piece type
-  void get_pawn_moves(std::vector<Move> &move_list,
-                      const square_t location) const;
-  void get_knight_moves(std::vector<Move> &move_list,
-                        const square_t location) const;
-  void get_slide_move_helper(std::vector<Move> &move_list,
-                             const square_t location, int dx, int dy) const;
-  void get_bishop_moves(std::vector<Move> &move_list,
-                        const square_t location) const;
-  void get_rook_moves(std::vector<Move> &move_list,
-                      const square_t location) const;
-  void get_queen_moves(std::vector<Move> &move_list,
-                       const square_t location) const;
-  void get_king_moves(std::vector<Move> &move_list,
-                      const square_t location) const;
+  // whether a pawn of the side to move can take en passant, ignoring pins:
+  // only then is the en passant file part of the hash, so that positions
+  // which differ only by a double push nobody can answer hash the same
+  inline bool en_passant_capturable() const {
+    return en_passant != InvalidSquare &&
+           (pawn_attackers_bb(en_passant, side_to_move) &
+            piece_bb[make_piece(side_to_move, Pawn)]);
+  }
+  // sets up a position that has already been checked, with no moves made
+  void set_position(const piece_t (&new_pieces)[64],
+                    const colour_t new_side_to_move,
+                    const int new_castle_perms, const square_t new_en_passant,
+                    const int new_fifty_move, const int new_full_move);
+
+  inline void add_dirty_piece(const piece_t piece, const square_t from,
+                              const square_t to) {
+    assert(dirty_count < 4);
+    dirty_pieces[dirty_count++] = {piece, from, to};
+  }
+  // brings the accumulator up to date with the dirty pieces and clears them
+  void update_accumulator();
+  void refresh_accumulator(Accumulator &target) const;
+
+  // adds moves to a given move list by piece type: only moves to a square in
+  // targets are added, except for en passant and king moves, which Legal
+  // generation checks separately. Pawns and kings also filter on Type
+  // themselves, since a promotion push is a Captures move to an empty square
+  template <GenType Type, Colour Us>
+  void get_pawn_moves(MoveList &move_list, const square_t location,
+                      const bitboard_t targets) const;
+  void get_knight_moves(MoveList &move_list, const square_t location,
+                        const bitboard_t targets) const;
+  // adds a move from location to every square in targets
+  void get_target_moves(MoveList &move_list, const square_t location,
+                        bitboard_t targets) const;
+  void get_bishop_moves(MoveList &move_list, const square_t location,
+                        const bitboard_t targets) const;
+  void get_rook_moves(MoveList &move_list, const square_t location,
+                      const bitboard_t targets) const;
+  void get_queen_moves(MoveList &move_list, const square_t location,
+                       const bitboard_t targets) const;
+  template <GenType Type, Colour Us>
+  void get_king_moves(MoveList &move_list, const square_t location) const;
+  // dispatches on the piece standing on location
+  template <GenType Type, Colour Us>
+  void get_piece_moves(MoveList &move_list, const square_t location,
+                       const bitboard_t targets) const;
+
+  // the halves of generate, make_move, unmake_move and is_square_attacked
+  // specialised on a colour (the side to move, the side that made the move
+  // and the attacking side), so that every per-colour constant they use is
+  // known at compile time. The public functions dispatch on the colour once.
+  template <GenType Type, Colour Us>
+  void generate_moves(MoveList &move_list) const;
+  template <Colour Us> bool do_make_move(const PackedMove move);
+  template <Colour Us> void do_unmake_move();
+  template <Colour By> bool is_attacked_by(const square_t sq) const;
+
+  // whether the en passant capture by the pawn on from leaves the king safe:
+  // it empties two squares on the same rank, which no pin mask captures
+  bool is_legal_en_passant(const square_t from) const;
 };
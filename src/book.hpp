@@ -0,0 +1,53 @@
+
+#pragma once
+
+#include "file_contents.hpp"
+#include "move.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+
+class Board;
+
+// how a move is chosen among a position's book moves
+enum BookSelection {
+  // at random, in proportion to the weights
+  BookWeighted,
+  // the move with the highest weight
+  BookBest
+};
+
+// A Polyglot opening book: a .bin file of 16 byte entries, each a position's
+// key, a move, a weight and a learn value (all big endian), sorted by key.
+// The file is memory mapped read only, so several engines using one book
+// share a single copy in the page cache, and a position's entries are found
+// by binary search on the key. Polyglot keys are Zobrist keys made from the
+// Random64 table of the Polyglot specification, not from our own.
+class OpeningBook {
+  std::unique_ptr<FileContents> file;
+  const unsigned char *data = nullptr;
+  size_t entry_count = 0;
+
+  std::mt19937_64 rng{std::random_device{}()};
+
+public:
+  OpeningBook() = default;
+  OpeningBook(const OpeningBook &) = delete;
+  OpeningBook &operator=(const OpeningBook &) = delete;
+
+  // maps a book file, closing the current one: returns false, leaving no book
+  // open, if it can't be read or isn't a whole number of entries
+  bool open(const std::string &path);
+  void close();
+  inline bool is_open() const { return data != nullptr; }
+  inline size_t size() const { return entry_count; }
+
+  // the Polyglot key of a position
+  static uint64_t key(const Board &board);
+  // a book move for the position, or none if the book has no legal move for
+  // it (or is not open)
+  PackedMove probe(const Board &board, const BookSelection selection);
+};
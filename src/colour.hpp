@@ -3,3 +3,8 @@
 
 enum Colour { White = 1, Black = -1, InvalidColour = 0 };
 using colour_t = int;
+
+// maps White -> 0 and Black -> 1, for indexing per-colour tables
+constexpr int colour_index(const colour_t colour) {
+  return colour == White ? 0 : 1;
+}
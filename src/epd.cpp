@@ -0,0 +1,137 @@
+
+#include "epd.hpp"
+
+#include "file_contents.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+// splits text into about count pieces, each ending just after a newline (or
+// at the end of the text), so that no line is cut in two
+std::vector<std::string_view> split_lines(const std::string_view text,
+                                          const size_t count) {
+  std::vector<std::string_view> chunks;
+  const size_t target = std::max<size_t>(text.size() / count, 1);
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = std::min(start + target, text.size());
+    end = text.find('\n', end - 1);
+    end = end == std::string_view::npos ? text.size() : end + 1;
+    chunks.push_back(text.substr(start, end - start));
+    start = end;
+  }
+  return chunks;
+}
+
+// parses every line of a chunk into board, calling found after each one;
+// returns the number of lines which didn't parse
+template <typename Found>
+size_t parse_chunk(std::string_view chunk, Board &board, const Found &found) {
+  size_t errors = 0;
+  while (!chunk.empty()) {
+    const size_t end = std::min(chunk.find('\n'), chunk.size());
+    const std::string_view line = chunk.substr(0, end);
+    chunk.remove_prefix(std::min(end + 1, chunk.size()));
+
+    const size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos || line[first] == '#')
+      continue;
+    if (board.set_fen(line) == FenOk)
+      found(board);
+    else
+      errors++;
+  }
+  return errors;
+}
+
+double seconds_since(const std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// splits the file into chunks, calls prepare(number of chunks) and then runs
+// parse(chunk index, chunk, worker) over them on the pool, where parse returns
+// the number of positions found and lines rejected
+template <typename Prepare, typename Parse>
+EpdLoadResult load_chunks(const std::string &path, const int threads,
+                          const Prepare &prepare, const Parse &parse) {
+  EpdLoadResult result;
+  const FileContents file(path);
+  if (!file.is_open())
+    return result;
+  result.opened = true;
+
+  // several chunks per thread, so a thread which finishes early can steal
+  const std::vector<std::string_view> chunks =
+      split_lines(file.view(), 8 * static_cast<size_t>(threads));
+  prepare(chunks.size());
+  std::atomic<size_t> positions{0}, errors{0};
+  ThreadPool pool(threads);
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    pool.submit([&, i](const int worker) {
+      const auto [found, rejected] = parse(i, chunks[i], worker);
+      positions += found;
+      errors += rejected;
+    });
+  }
+  pool.wait();
+
+  result.positions = positions;
+  result.errors = errors;
+  return result;
+}
+
+} // namespace
+
+EpdLoadResult load_epd(const std::string &path, const EpdCallback &callback,
+                       const int threads) {
+  const auto start = std::chrono::steady_clock::now();
+  EpdLoadResult result = load_chunks(
+      path, threads, [](size_t) {},
+      [&](size_t, const std::string_view chunk, const int worker) {
+        // one board per chunk, set up afresh for every line
+        Board board;
+        size_t found = 0;
+        const size_t rejected =
+            parse_chunk(chunk, board, [&](const Board &position) {
+              callback(position, worker);
+              found++;
+            });
+        return std::make_pair(found, rejected);
+      });
+  result.seconds = seconds_since(start);
+  return result;
+}
+
+EpdLoadResult load_epd(const std::string &path,
+                       std::vector<PackedPosition> &positions,
+                       const int threads) {
+  const auto start = std::chrono::steady_clock::now();
+  // each chunk fills its own list, so that they can be joined in file order
+  std::vector<std::vector<PackedPosition>> chunk_positions;
+  EpdLoadResult result = load_chunks(
+      path, threads,
+      [&](const size_t chunks) { chunk_positions.resize(chunks); },
+      [&](const size_t index, const std::string_view chunk, int) {
+        Board board;
+        std::vector<PackedPosition> &found = chunk_positions[index];
+        const size_t rejected =
+            parse_chunk(chunk, board, [&](const Board &position) {
+              found.push_back(position.pack());
+            });
+        return std::make_pair(found.size(), rejected);
+      });
+
+  positions.reserve(positions.size() + result.positions);
+  for (const std::vector<PackedPosition> &found : chunk_positions)
+    positions.insert(positions.end(), found.begin(), found.end());
+  result.seconds = seconds_since(start);
+  return result;
+}
@@ -0,0 +1,42 @@
+
+#pragma once
+
+#include "board.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct EpdLoadResult {
+  // false if the file could not be opened or mapped
+  bool opened = false;
+  size_t positions = 0;
+  // non-blank lines which set_fen rejected, and were skipped
+  size_t errors = 0;
+  double seconds = 0;
+
+  double positions_per_second() const {
+    return seconds > 0 ? static_cast<double>(positions) / seconds : 0;
+  }
+};
+
+// Called with each position loaded and the index of the worker thread which
+// parsed it: calls from different workers run concurrently.
+using EpdCallback = std::function<void(const Board &board, int worker)>;
+
+// Memory maps an EPD file, or a file of one FEN per line, and parses it on
+// threads worker threads, each taking chunks of whole lines. Blank lines and
+// lines starting with '#' are skipped, as is anything after the four EPD
+// fields (or the six FEN ones) on a line. Positions reach the callback in no
+// particular order.
+EpdLoadResult load_epd(const std::string &path, const EpdCallback &callback,
+                       const int threads);
+
+// the same, appending the positions to positions in file order. They are
+// kept packed, since a Board is several kilobytes (mostly its state history
+// and NNUE accumulator) and a file of millions of them would not fit in
+// memory: Board::set_packed sets one up when it is needed.
+EpdLoadResult load_epd(const std::string &path,
+                       std::vector<PackedPosition> &positions,
+                       const int threads);
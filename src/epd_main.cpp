@@ -0,0 +1,54 @@
+
+#include "epd.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Loads every position of an EPD file and reports how fast it went: the
+// positions/second printed here tracks the cost of bulk loading.
+int main(int argc, char *argv[]) {
+  std::string path;
+  int threads =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc)
+      threads = std::max(1, std::atoi(argv[++i]));
+    else
+      path = arg;
+  }
+  if (path.empty()) {
+    std::cerr << "usage: " << argv[0] << " <file> [--threads <n>]\n"
+              << "  --threads <n>  parse the file on n threads\n";
+    return EXIT_FAILURE;
+  }
+
+  // XOR of every position's key, so that runs can be compared and the parse
+  // can't be optimised away
+  std::atomic<uint64_t> checksum{0};
+  const EpdLoadResult result = load_epd(
+      path,
+      [&](const Board &board, int) {
+        checksum.fetch_xor(board.get_hash(), std::memory_order_relaxed);
+      },
+      threads);
+  if (!result.opened) {
+    std::cerr << "could not open " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Positions: " << result.positions << "\n"
+            << "Errors: " << result.errors << "\n"
+            << "Checksum: " << std::hex << checksum << std::dec << "\n"
+            << "Time: " << static_cast<int64_t>(result.seconds * 1000)
+            << " ms\n"
+            << "Positions/s: "
+            << static_cast<int64_t>(result.positions_per_second())
+            << std::endl;
+}
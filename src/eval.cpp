@@ -0,0 +1,23 @@
+
+#include "eval.hpp"
+
+#include <utility>
+
+namespace {
+
+std::vector<std::unique_ptr<EvalTerm>> &eval_terms() {
+  static std::vector<std::unique_ptr<EvalTerm>> terms;
+  return terms;
+}
+
+} // namespace
+
+void add_eval_term(std::unique_ptr<EvalTerm> term) {
+  eval_terms().push_back(std::move(term));
+}
+
+void clear_eval_terms() { eval_terms().clear(); }
+
+const std::vector<std::unique_ptr<EvalTerm>> &get_eval_terms() {
+  return eval_terms();
+}
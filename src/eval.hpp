@@ -0,0 +1,25 @@
+
+#pragma once
+
+#include "psqt.hpp"
+
+#include <memory>
+#include <vector>
+
+class Board;
+
+// An evaluation term on top of the incremental material and piece-square
+// score: Board::static_evaluation adds up the terms' scores with its own and
+// tapers the total, so a term only has to say what it sees in the position.
+class EvalTerm {
+public:
+  virtual ~EvalTerm() = default;
+  // a white relative score for the position
+  virtual Score evaluate(const Board &board) const = 0;
+};
+
+// the terms static_evaluation uses, in order: the list is read without
+// locking, so change it only while nothing is evaluating
+void add_eval_term(std::unique_ptr<EvalTerm> term);
+void clear_eval_terms();
+const std::vector<std::unique_ptr<EvalTerm>> &get_eval_terms();
@@ -0,0 +1,61 @@
+
+#include "file_contents.hpp"
+
+#include <fstream>
+#include <iterator>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileContents::FileContents(const std::string &path, const FileAccess access) {
+#ifdef __linux__
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    size = static_cast<size_t>(info.st_size);
+    void *memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (memory != MAP_FAILED) {
+      // advice values are not flags: each needs a call of its own
+      if (access == SequentialAccess) {
+        madvise(memory, size, MADV_SEQUENTIAL);
+        madvise(memory, size, MADV_WILLNEED);
+      } else {
+        madvise(memory, size, MADV_RANDOM);
+      }
+      mapping = memory;
+      data = static_cast<const char *>(memory);
+    } else {
+      size = 0;
+    }
+  } else if (fstat(fd, &info) == 0) {
+    // an empty file can't be mapped, but is still a file
+    data = "";
+  }
+  // the mapping keeps the file open
+  close(fd);
+  if (data)
+    return;
+#else
+  (void)access;
+#endif
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return;
+  buffer.assign(std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>());
+  data = buffer.data();
+  size = buffer.size();
+}
+
+FileContents::~FileContents() {
+#ifdef __linux__
+  if (mapping)
+    munmap(mapping, size);
+#endif
+}
@@ -0,0 +1,37 @@
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// how a file's contents will be read, as advice to the OS
+enum FileAccess {
+  // every page once, from front to back: read ahead
+  SequentialAccess,
+  // scattered reads, such as a binary search: don't read ahead
+  RandomAccess
+};
+
+// The contents of a file, read only: mapped where mmap is available, so
+// processes reading the same file share one copy in the page cache, and read
+// into memory otherwise.
+class FileContents {
+  const char *data = nullptr;
+  size_t size = 0;
+#ifdef __linux__
+  void *mapping = nullptr;
+#endif
+  std::string buffer;
+
+public:
+  explicit FileContents(const std::string &path,
+                        const FileAccess access = SequentialAccess);
+  FileContents(const FileContents &) = delete;
+  FileContents &operator=(const FileContents &) = delete;
+  ~FileContents();
+
+  // false if the file couldn't be opened; an empty file is still open
+  bool is_open() const { return data != nullptr; }
+  std::string_view view() const { return std::string_view(data, size); }
+};
@@ -1,29 +1,238 @@
 
 #include "board.hpp"
-#include "piece.hpp"
-#include "square.hpp"
+#include "nnue.hpp"
+#include "search.hpp"
+#include "uci.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 // #include <glog/logging.h>
+#include <iomanip>
 #include <iostream>
 #include <string>
+#include <vector>
 
+namespace {
+
+void print_usage(const char *program) {
+  std::cerr << "usage: " << program
+            << " [fen] [--depth <n>] [--nodes <n>] [--movetime <ms>]"
+               " [--clock <ms> [--inc <ms>] [--movestogo <n>]]"
+               " [--threads <n>] [--nnue <file>] [--time-selftest]\n"
+               "  with no arguments, speaks UCI on stdin and stdout\n"
+               "  --depth <n>        search n plies deep (default 8 when\n"
+               "                     there is no other limit)\n"
+               "  --nodes <n>        stop after about n nodes\n"
+               "  --movetime <ms>    stop after ms milliseconds\n"
+               "  --clock <ms>       think as if ms were left on our clock\n"
+               "  --inc <ms>         with an increment of ms a move\n"
+               "  --movestogo <n>    and n moves to the next time control\n"
+               "  --threads <n>      search on n threads\n"
+               "  --nnue <file>      evaluate with the network in file\n"
+               "  --time-selftest    measure how well the time manager keeps\n"
+               "                     to its limits, and what polling costs\n";
+}
+
+int64_t elapsed_ms(const std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Plays a few positions on a range of clocks, comparing the time each search
+// used with the soft and hard limits it was given, then measures what the
+// clock polling costs the search.
+int time_selftest(const int threads) {
+  struct Clock {
+    int64_t time_ms;
+    int64_t increment_ms;
+    int moves_to_go;
+  };
+  const std::vector<Clock> clocks = {
+      {30000, 0, 0}, {10000, 100, 0}, {3000, 30, 0},
+      {1000, 10, 0}, {200, 0, 0},     {2000, 0, 5}};
+  const std::vector<std::string> fens = {
+      Board::start_fen,
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+      "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  };
+
+  SearchPool search(threads);
+  std::cout << std::setw(8) << "clock" << std::setw(6) << "inc" << std::setw(5)
+            << "mtg" << std::setw(8) << "soft" << std::setw(8) << "hard"
+            << std::setw(8) << "used" << std::setw(10) << "used/soft"
+            << std::endl;
+  double total_ratio = 0;
+  int64_t worst_overshoot = 0;
+  int searches = 0, over_hard = 0;
+  for (const Clock &clock : clocks) {
+    for (const std::string &fen : fens) {
+      SearchLimits limits;
+      limits.time_left_ms = clock.time_ms;
+      limits.increment_ms = clock.increment_ms;
+      limits.moves_to_go = clock.moves_to_go;
+      search.clear();
+      const Board board(fen);
+      const auto start = std::chrono::steady_clock::now();
+      search.start(board, limits);
+      search.run(board, limits);
+      const int64_t used = elapsed_ms(start);
+
+      const TimeManager &time = search.get_time_manager();
+      const double ratio = static_cast<double>(used) /
+                           std::max<int64_t>(time.get_soft_limit(), 1);
+      total_ratio += ratio;
+      searches++;
+      over_hard += used > time.get_hard_limit();
+      worst_overshoot =
+          std::max(worst_overshoot, used - time.get_hard_limit());
+      std::cout << std::setw(8) << clock.time_ms << std::setw(6)
+                << clock.increment_ms << std::setw(5) << clock.moves_to_go
+                << std::setw(8) << time.get_soft_limit() << std::setw(8)
+                << time.get_hard_limit() << std::setw(8) << used
+                << std::setw(10) << std::fixed << std::setprecision(2) << ratio
+                << std::endl;
+    }
+  }
+  std::cout << "Mean used/soft: " << total_ratio / searches << "\n"
+            << "Over the hard limit: " << over_hard << " of " << searches
+            << " (worst by " << std::max<int64_t>(worst_overshoot, 0)
+            << " ms)" << std::endl;
+
+  // the cost of a clock read, which the search pays once every
+  // limit_check_nodes nodes
+  constexpr int reads = 1000000;
+  const auto start = std::chrono::steady_clock::now();
+  int64_t sink = 0;
+  for (int i = 0; i < reads; ++i)
+    sink += std::chrono::steady_clock::now().time_since_epoch().count() & 1;
+  const double read_ns =
+      std::chrono::duration<double, std::nano>(
+          std::chrono::steady_clock::now() - start)
+          .count() /
+      reads;
+  std::cout << "Clock read: " << read_ns << " ns (" << sink % 2
+            << "), polled every " << limit_check_nodes << " nodes: "
+            << read_ns / limit_check_nodes << " ns a node" << std::endl;
+
+  // and the whole of it, as the speed of a fixed node search with and
+  // without a clock to watch
+  double nps[2];
+  for (const bool with_clock : {false, true}) {
+    SearchLimits limits;
+    limits.nodes = 2000000;
+    if (with_clock)
+      limits.movetime_ms = 1000000;
+    search.clear();
+    const Board board(fens[1]);
+    const auto search_start = std::chrono::steady_clock::now();
+    search.start(board, limits);
+    const SearchResult result = search.run(board, limits);
+    nps[with_clock] =
+        result.nodes /
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      search_start)
+            .count();
+  }
+  std::cout << "NPS without a clock: " << static_cast<int64_t>(nps[0])
+            << ", with: " << static_cast<int64_t>(nps[1]) << std::endl;
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+// Without arguments runs the UCI loop. Otherwise searches one position,
+// printing a UCI info line per iteration and then the best move.
 int main(int argc, char *argv[]) {
   // Initialize Google’s logging library.
   // google::InitGoogleLogging(argv[0]);
   // LOG(INFO) << "Hello World";
 
-  const std::string starting_fen = "4k3/8/8/8/8/3b4/8/R3K2R w KQ - 0 1";
-  Board board = Board(starting_fen);
-  board.print_board();
-  const std::vector<Move> pseudo_legal_moves =
-      board.generate_pseudo_legal_moves();
-  std::cout << "Found " << pseudo_legal_moves.size()
-            << " legal moves:" << std::endl;
-
-  for (const Move move : pseudo_legal_moves) {
-    std::cout << string_from_square(move.from) << " to "
-              << string_from_square(move.to) << std::endl;
+  if (argc == 1) {
+    Uci(std::cin, std::cout).loop();
+    return EXIT_SUCCESS;
+  }
+
+  std::string fen;
+  SearchLimits limits;
+  int depth = 0;
+  int threads = 1;
+  bool selftest = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--depth" && i + 1 < argc) {
+      depth = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--nodes" && i + 1 < argc) {
+      limits.nodes = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--movetime" && i + 1 < argc) {
+      limits.movetime_ms = std::atoll(argv[++i]);
+    } else if (arg == "--clock" && i + 1 < argc) {
+      limits.time_left_ms = std::atoll(argv[++i]);
+    } else if (arg == "--inc" && i + 1 < argc) {
+      limits.increment_ms = std::atoll(argv[++i]);
+    } else if (arg == "--movestogo" && i + 1 < argc) {
+      limits.moves_to_go = std::atoi(argv[++i]);
+    } else if (arg == "--time-selftest") {
+      selftest = true;
+    } else if (arg == "--threads" && i + 1 < argc) {
+      threads = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--nnue" && i + 1 < argc) {
+      if (!nnue_network.load(argv[++i])) {
+        std::cerr << "could not load network " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if (arg.rfind("--", 0) == 0) {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    } else {
+      fen += (fen.empty() ? "" : " ") + arg;
+    }
   }
+  if (selftest)
+    return time_selftest(threads);
+  if (depth)
+    limits.depth = depth;
+  else if (!limits.nodes && !limits.movetime_ms && limits.time_left_ms < 0)
+    limits.depth = 8;
+
+  Board board;
+  if (!fen.empty()) {
+    const FenError error = board.set_fen(fen);
+    if (error != FenOk) {
+      std::cerr << "bad fen: " << fen_error_message(error) << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  board.print_board();
+
+  // how good the move ordering is: the share of cutoffs from the first move,
+  // and the effective branching factor from one iteration to the next
+  uint64_t previous_nodes = 0;
+  const auto report = [&previous_nodes](const SearchInfo &info) {
+    print_info(std::cout, info);
+    const SearchStats &stats = info.stats;
+    std::cout << "info string cutoffs " << stats.beta_cutoffs
+              << " first move "
+              << 100.0 * stats.first_move_cutoffs /
+                     std::max<uint64_t>(stats.beta_cutoffs, 1)
+              << "%";
+    if (previous_nodes)
+      std::cout << " ebf "
+                << static_cast<double>(info.nodes) / previous_nodes;
+    std::cout << std::endl;
+    previous_nodes = info.nodes;
+  };
+
+  SearchPool search(threads);
+  search.start(board, limits);
+  const SearchResult result = search.run(board, limits, report);
+  std::cout << "bestmove "
+            << (result.best_move == PackedMove::none()
+                    ? "0000"
+                    : result.best_move.to_uci());
+  if (result.ponder_move != PackedMove::none())
+    std::cout << " ponder " << result.ponder_move.to_uci();
+  std::cout << std::endl;
 }
@@ -1,2 +1,11 @@
 
 #include "move.hpp"
+
+std::string PackedMove::to_uci() const {
+  if (*this == none())
+    return "0000";
+  std::string result = string_from_square(from()) + string_from_square(to());
+  if (is_promotion())
+    result += "nbrq"[promotion_type() - Knight];
+  return result;
+}
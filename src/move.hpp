@@ -4,6 +4,11 @@
 #include "piece.hpp"
 #include "square.hpp"
 
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <utility>
+
 enum MoveType {
   ShortCastle,
   LongCastle,
@@ -16,15 +21,113 @@ enum MoveType {
 };
 
 struct Move {
-  square_t from = InvalidSquare;
-  square_t to = InvalidSquare;
-  MoveType type = Quiet;
-  piece_t promotion_piece = InvalidPiece;
-  piece_t captured_piece = InvalidPiece;
+  square_t from;
+  square_t to;
+  MoveType type;
+  piece_t promotion_piece;
+  piece_t captured_piece;
 
 public:
+  Move() = default;
   Move(const square_t from, const square_t to, const MoveType type,
        const piece_t promotion_piece, const piece_t captured_piece)
       : from(from), to(to), type(type), promotion_piece(promotion_piece),
         captured_piece(captured_piece) {}
 };
+
+// A move packed into 16 bits: bits 0-5 hold the from square, bits 6-11 the to
+// square and bits 12-15 the flags. Flags below 8 are the MoveType itself;
+// promotions set bit 3, bit 2 for a capture and bits 0-1 for the promotion
+// piece type (Knight to Queen). The captured piece is not stored: make_move
+// reads it off the board.
+class PackedMove {
+  uint16_t data;
+
+  constexpr static int promotion_flag = 8;
+  constexpr static int capture_promotion_flag = 12;
+
+  constexpr static int flags_of(const MoveType type, const int promotion_type) {
+    return type == Promotion        ? promotion_flag + promotion_type - Knight
+           : type == CapturePromote ? capture_promotion_flag + promotion_type -
+                                          Knight
+                                    : type;
+  }
+
+public:
+  // left uninitialized, so that declaring a MoveList costs nothing
+  PackedMove() = default;
+  constexpr explicit PackedMove(const uint16_t data) : data(data) {}
+  constexpr PackedMove(const square_t from, const square_t to,
+                       const MoveType type, const int promotion_type = Knight)
+      : data(static_cast<uint16_t>(from | to << 6 |
+                                   flags_of(type, promotion_type) << 12)) {}
+  constexpr PackedMove(const Move &move)
+      : PackedMove(move.from, move.to, move.type,
+                   move.promotion_piece == InvalidPiece
+                       ? Knight
+                       : piece_type(move.promotion_piece)) {}
+
+  // a8a8 can never be played, so the all zero move stands for "no move"
+  constexpr static PackedMove none() { return PackedMove(uint16_t(0)); }
+
+  constexpr square_t from() const { return data & 63; }
+  constexpr square_t to() const { return (data >> 6) & 63; }
+  constexpr int flags() const { return data >> 12; }
+  constexpr MoveType type() const {
+    return flags() < promotion_flag ? static_cast<MoveType>(flags())
+           : flags() < capture_promotion_flag ? Promotion
+                                              : CapturePromote;
+  }
+  constexpr bool is_promotion() const { return flags() >= promotion_flag; }
+  constexpr bool is_capture() const {
+    return flags() == Capture || flags() == EnPassant ||
+           flags() >= capture_promotion_flag;
+  }
+  // only meaningful for promotions
+  constexpr int promotion_type() const { return Knight + (flags() & 3); }
+  constexpr uint16_t raw() const { return data; }
+
+  constexpr bool operator==(const PackedMove other) const {
+    return data == other.data;
+  }
+  constexpr bool operator!=(const PackedMove other) const {
+    return data != other.data;
+  }
+
+  // long algebraic notation, as used by UCI (e.g. e2e4, e7e8q)
+  std::string to_uci() const;
+};
+
+static_assert(sizeof(PackedMove) == 2);
+
+// no legal chess position has more than 218 moves
+constexpr int max_moves = 256;
+
+// A fixed-capacity list of moves stored inline, so that generating moves never
+// touches the heap. Supports the parts of the std::vector interface that move
+// generation and its callers use.
+class MoveList {
+  PackedMove moves[max_moves];
+  int count = 0;
+
+public:
+  template <typename... Args> inline void emplace_back(Args &&...args) {
+    assert(count < max_moves);
+    moves[count++] = PackedMove(std::forward<Args>(args)...);
+  }
+  inline void push_back(const PackedMove move) {
+    assert(count < max_moves);
+    moves[count++] = move;
+  }
+  inline void clear() { count = 0; }
+
+  inline int size() const { return count; }
+  inline bool empty() const { return count == 0; }
+  inline PackedMove &operator[](const int i) { return moves[i]; }
+  inline const PackedMove &operator[](const int i) const { return moves[i]; }
+
+  inline PackedMove *begin() { return moves; }
+  inline PackedMove *end() { return moves + count; }
+  inline const PackedMove *begin() const { return moves; }
+  inline const PackedMove *end() const { return moves + count; }
+};
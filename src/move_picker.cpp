@@ -0,0 +1,166 @@
+
+#include "move_picker.hpp"
+
+#include <algorithm>
+#include <utility>
+
+MovePicker::MovePicker(const Board &board, const PackedMove hash_move,
+                       const PackedMove killer1, const PackedMove killer2,
+                       const PackedMove counter_move,
+                       const ButterflyHistory *history)
+    : MovePicker(board, hash_move, AllMoves, killer1, killer2, counter_move,
+                 history) {}
+
+MovePicker::MovePicker(const Board &board, const PackedMove hash_move,
+                       const Mode mode)
+    : MovePicker(board, hash_move, mode, PackedMove::none(),
+                 PackedMove::none(), PackedMove::none(), nullptr) {}
+
+MovePicker::MovePicker(const Board &board, const PackedMove hash_move,
+                       const Mode mode, const PackedMove killer1,
+                       const PackedMove killer2, const PackedMove counter_move,
+                       const ButterflyHistory *history)
+    : board(board), hash_move(hash_move),
+      refutations{killer1, killer2, counter_move}, history(history) {
+  // in check every evasion is handed out, whatever the mode
+  const bool in_check = board.in_check();
+  const bool captures_only = mode == CapturesOnly && !in_check;
+  stage = in_check        ? EvasionHashMove
+          : captures_only ? QuiescenceHashMove
+                          : HashMove;
+  // a hash move from another position sharing the key, or from a collision,
+  // must never be played, and the quiescence search only plays captures and
+  // promotions
+  if (hash_move == PackedMove::none() ||
+      (captures_only && !hash_move.is_capture() &&
+       !hash_move.is_promotion()) ||
+      !board.is_pseudo_legal(hash_move))
+    stage++;
+}
+
+int MovePicker::capture_score(const PackedMove move) const {
+  const piece_t attacker = board.get_piece(move.from());
+  int victim_value = 0;
+  if (move.type() == EnPassant)
+    victim_value = see_values[Pawn];
+  else if (move.is_capture())
+    victim_value = see_values[piece_type(board.get_piece(move.to()))];
+  if (move.is_promotion())
+    victim_value += see_values[move.promotion_type()];
+  // the attacker only breaks ties between equal victims
+  return 64 * victim_value - piece_type(attacker);
+}
+
+PackedMove MovePicker::pick_best() {
+  int best = current;
+  for (int i = current + 1; i < moves.size(); ++i) {
+    if (scores[i] > scores[best])
+      best = i;
+  }
+  std::swap(moves[current], moves[best]);
+  std::swap(scores[current], scores[best]);
+  return moves[current++];
+}
+
+PackedMove MovePicker::next_move() {
+  switch (stage) {
+  case HashMove:
+  case EvasionHashMove:
+  case QuiescenceHashMove:
+    stage++;
+    return hash_move;
+
+  case GenerateCaptures:
+    board.generate<Captures>(moves);
+    for (int i = 0; i < moves.size(); ++i)
+      scores[i] = capture_score(moves[i]);
+    stage++;
+    [[fallthrough]];
+  case GoodCaptures:
+    while (current < moves.size()) {
+      const PackedMove move = pick_best();
+      if (move == hash_move)
+        continue;
+      if (!board.see_ge(move)) {
+        bad_captures.push_back(move);
+        continue;
+      }
+      return move;
+    }
+    stage++;
+    [[fallthrough]];
+  case Refutations:
+    while (refutation_index < 3) {
+      const int i = refutation_index++;
+      const PackedMove move = refutations[i];
+      if (move != PackedMove::none() && move != hash_move &&
+          std::find(refutations, refutations + i, move) == refutations + i &&
+          !move.is_capture() && !move.is_promotion() &&
+          board.is_pseudo_legal(move))
+        return move;
+    }
+    stage++;
+    [[fallthrough]];
+  case GenerateQuiets:
+    moves.clear();
+    board.generate<Quiets>(moves);
+    current = 0;
+    if (history) {
+      const colour_t side = board.get_side_to_move();
+      for (int i = 0; i < moves.size(); ++i)
+        scores[i] = history->get(side, moves[i]);
+    }
+    stage++;
+    [[fallthrough]];
+  case QuietMoves:
+    while (current < moves.size()) {
+      const PackedMove move = history ? pick_best() : moves[current++];
+      if (move != hash_move &&
+          std::find(refutations, refutations + 3, move) == refutations + 3)
+        return move;
+    }
+    stage++;
+    [[fallthrough]];
+  case BadCaptures:
+    if (bad_capture_index < bad_captures.size())
+      return bad_captures[bad_capture_index++];
+    stage = Done;
+    return PackedMove::none();
+
+  case GenerateQuiescenceCaptures:
+    board.generate<Captures>(moves);
+    for (int i = 0; i < moves.size(); ++i)
+      scores[i] = capture_score(moves[i]);
+    stage++;
+    [[fallthrough]];
+  case QuiescenceCaptures:
+    // losing captures are dropped rather than put off
+    while (current < moves.size()) {
+      const PackedMove move = pick_best();
+      if (move != hash_move && board.see_ge(move))
+        return move;
+    }
+    stage = Done;
+    return PackedMove::none();
+
+  case GenerateEvasions:
+    board.generate<Evasions>(moves);
+    for (int i = 0; i < moves.size(); ++i)
+      scores[i] = moves[i].is_capture() || moves[i].is_promotion()
+                      ? capture_score(moves[i])
+                      : -1;
+    stage++;
+    [[fallthrough]];
+  case EvasionMoves:
+    while (current < moves.size()) {
+      const PackedMove move = pick_best();
+      if (move != hash_move)
+        return move;
+    }
+    stage = Done;
+    return PackedMove::none();
+
+  default:
+    return PackedMove::none();
+  }
+}
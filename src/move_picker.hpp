@@ -0,0 +1,114 @@
+
+#pragma once
+
+#include "board.hpp"
+#include "move.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// the most a history score can reach either way
+constexpr int history_max = 16384;
+
+// Butterfly history: a score for every quiet move, by the side making it and
+// its from and to squares, for how often it has caused a beta cutoff. Each
+// update pulls the score towards the bonus's limit in proportion to how far
+// away it still is ("gravity"), so scores stay within +-history_max and old
+// results fade as new ones come in.
+class ButterflyHistory {
+  int16_t scores[2][64][64];
+
+public:
+  ButterflyHistory() { clear(); }
+
+  void clear() { std::memset(scores, 0, sizeof(scores)); }
+  inline int get(const colour_t side, const PackedMove move) const {
+    return scores[colour_index(side)][move.from()][move.to()];
+  }
+  // a positive bonus for a move which caused a cutoff, negative for one
+  // which was searched before it and didn't
+  inline void update(const colour_t side, const PackedMove move,
+                     const int bonus) {
+    int16_t &score = scores[colour_index(side)][move.from()][move.to()];
+    score += bonus - score * std::abs(bonus) / history_max;
+  }
+};
+
+// Hands out the moves of a position one at a time, most promising first, and
+// only generates each batch of moves once the one before it has run out: most
+// beta cutoffs come from the first move or two, so the later batches are
+// usually never generated at all.
+//
+// Out of check the order is the hash move, the captures and promotions which
+// don't lose material (most valuable victim first), the killers and the
+// counter move, the quiet moves by history score and finally the losing
+// captures. In check it is the hash move and
+// then the evasions, captures first. Apart from the evasions the moves are only
+// pseudo legal, so make_move must still be checked.
+//
+// The quiescence search's picker only hands out the hash move, if it is a
+// capture or promotion, and the captures and promotions which don't lose
+// material. In check it hands out every evasion, as usual.
+class MovePicker {
+public:
+  // which moves the picker hands out
+  enum Mode { AllMoves, CapturesOnly };
+
+  // the killers are quiet moves which caused a cutoff at the same ply
+  // elsewhere in the tree, the counter move one which refuted the last move
+  // played. Without a history the quiet moves come in generation order.
+  MovePicker(const Board &board, const PackedMove hash_move,
+             const PackedMove killer1 = PackedMove::none(),
+             const PackedMove killer2 = PackedMove::none(),
+             const PackedMove counter_move = PackedMove::none(),
+             const ButterflyHistory *history = nullptr);
+  MovePicker(const Board &board, const PackedMove hash_move, const Mode mode);
+
+  // the next move to try, or PackedMove::none() once there are no more
+  PackedMove next_move();
+
+private:
+  // what both public constructors do, each stage worked out once
+  MovePicker(const Board &board, const PackedMove hash_move, const Mode mode,
+             const PackedMove killer1, const PackedMove killer2,
+             const PackedMove counter_move, const ButterflyHistory *history);
+
+  enum Stage {
+    HashMove,
+    GenerateCaptures,
+    GoodCaptures,
+    Refutations,
+    GenerateQuiets,
+    QuietMoves,
+    BadCaptures,
+    QuiescenceHashMove,
+    GenerateQuiescenceCaptures,
+    QuiescenceCaptures,
+    EvasionHashMove,
+    GenerateEvasions,
+    EvasionMoves,
+    Done
+  };
+
+  // most valuable victim, least valuable attacker
+  int capture_score(const PackedMove move) const;
+  // swaps the best scored move left into moves[current] and returns it
+  PackedMove pick_best();
+
+  const Board &board;
+  const PackedMove hash_move;
+  // the killers, then the counter move
+  PackedMove refutations[3];
+  const ButterflyHistory *history;
+  int stage;
+
+  MoveList moves;
+  int scores[max_moves];
+  int current = 0;
+  int refutation_index = 0;
+
+  // losing captures, put off until after the quiet moves
+  MoveList bad_captures;
+  int bad_capture_index = 0;
+};
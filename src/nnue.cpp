@@ -0,0 +1,419 @@
+
+#include "nnue.hpp"
+
+#include "zobrist.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STARFISH_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+Network nnue_network;
+
+namespace {
+
+constexpr uint32_t file_magic = 0x4E4E4653; // "SFNN" read little endian
+constexpr uint32_t file_version = 1;
+// the hidden layers' weights are scaled by 2^hidden_shift, the output by
+// output_scale
+constexpr int hidden_shift = 6;
+constexpr int output_scale = 16;
+
+constexpr uint32_t file_header[] = {file_magic, file_version, nnue_features,
+                                    nnue_l1,    nnue_l2,      nnue_l3};
+
+static_assert(nnue_l1 % 32 == 0 && nnue_l2 == 32 && nnue_l3 == 32,
+              "the kernels assume these layer sizes");
+
+// Each kernel exists in a plain version, which is the reference, and in
+// SSE4.1 and AVX2 versions compiled for those instruction sets whatever the
+// build flags, so that one binary runs everywhere and still uses the best
+// the CPU has (unless STARFISH_NATIVE builds all of it for the build host).
+struct Kernels {
+  // accumulator[i] += row[i], or -=, over nnue_l1 values
+  void (*add_row)(int16_t *accumulator, const int16_t *row);
+  void (*sub_row)(int16_t *accumulator, const int16_t *row);
+  // clips nnue_l1 accumulator values to [0, 127]
+  void (*clip_accumulator)(const int16_t *input, uint8_t *output);
+  // output = bias + weights * input, weights being out_size rows of in_size
+  void (*affine)(const uint8_t *input, const int in_size,
+                 const int8_t *weights, const int32_t *bias, int32_t *output,
+                 const int out_size);
+  // scales down and clips 32 layer outputs to [0, 127]
+  void (*clip_hidden)(const int32_t *input, uint8_t *output);
+};
+
+void add_row_scalar(int16_t *accumulator, const int16_t *row) {
+  for (int i = 0; i < nnue_l1; ++i)
+    accumulator[i] += row[i];
+}
+
+void sub_row_scalar(int16_t *accumulator, const int16_t *row) {
+  for (int i = 0; i < nnue_l1; ++i)
+    accumulator[i] -= row[i];
+}
+
+void clip_accumulator_scalar(const int16_t *input, uint8_t *output) {
+  for (int i = 0; i < nnue_l1; ++i)
+    output[i] = static_cast<uint8_t>(std::clamp<int>(input[i], 0, 127));
+}
+
+void affine_scalar(const uint8_t *input, const int in_size,
+                   const int8_t *weights, const int32_t *bias, int32_t *output,
+                   const int out_size) {
+  for (int o = 0; o < out_size; ++o) {
+    int32_t sum = bias[o];
+    for (int i = 0; i < in_size; ++i)
+      sum += input[i] * weights[o * in_size + i];
+    output[o] = sum;
+  }
+}
+
+void clip_hidden_scalar(const int32_t *input, uint8_t *output) {
+  for (int i = 0; i < 32; ++i)
+    output[i] =
+        static_cast<uint8_t>(std::clamp(input[i] >> hidden_shift, 0, 127));
+}
+
+#ifdef STARFISH_X86_KERNELS
+
+__attribute__((target("sse4.1"))) void add_row_sse41(int16_t *accumulator,
+                                                     const int16_t *row) {
+  auto *acc = reinterpret_cast<__m128i *>(accumulator);
+  const auto *r = reinterpret_cast<const __m128i *>(row);
+  for (int i = 0; i < nnue_l1 / 8; ++i)
+    acc[i] = _mm_add_epi16(acc[i], r[i]);
+}
+
+__attribute__((target("sse4.1"))) void sub_row_sse41(int16_t *accumulator,
+                                                     const int16_t *row) {
+  auto *acc = reinterpret_cast<__m128i *>(accumulator);
+  const auto *r = reinterpret_cast<const __m128i *>(row);
+  for (int i = 0; i < nnue_l1 / 8; ++i)
+    acc[i] = _mm_sub_epi16(acc[i], r[i]);
+}
+
+__attribute__((target("sse4.1"))) void
+clip_accumulator_sse41(const int16_t *input, uint8_t *output) {
+  const auto *in = reinterpret_cast<const __m128i *>(input);
+  auto *out = reinterpret_cast<__m128i *>(output);
+  const __m128i zero = _mm_setzero_si128();
+  // saturating to [-128, 127] and then raising to 0 is the clip
+  for (int i = 0; i < nnue_l1 / 16; ++i)
+    out[i] = _mm_max_epi8(_mm_packs_epi16(in[2 * i], in[2 * i + 1]), zero);
+}
+
+__attribute__((target("sse4.1"))) int32_t hsum_sse41(const __m128i sum) {
+  const __m128i pairs = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  return _mm_cvtsi128_si32(
+      _mm_add_epi32(pairs, _mm_shuffle_epi32(pairs, 0xB1)));
+}
+
+__attribute__((target("sse4.1"))) void
+affine_sse41(const uint8_t *input, const int in_size, const int8_t *weights,
+             const int32_t *bias, int32_t *output, const int out_size) {
+  const auto *in = reinterpret_cast<const __m128i *>(input);
+  const __m128i ones = _mm_set1_epi16(1);
+  for (int o = 0; o < out_size; ++o) {
+    const auto *row = reinterpret_cast<const __m128i *>(weights + o * in_size);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < in_size / 16; ++i) {
+      // u8 x i8 pairs summed to i16 can't saturate with inputs up to 127
+      const __m128i products = _mm_maddubs_epi16(in[i], row[i]);
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(products, ones));
+    }
+    output[o] = bias[o] + hsum_sse41(sum);
+  }
+}
+
+__attribute__((target("sse4.1"))) void clip_hidden_sse41(const int32_t *input,
+                                                         uint8_t *output) {
+  const auto *in = reinterpret_cast<const __m128i *>(input);
+  auto *out = reinterpret_cast<__m128i *>(output);
+  const __m128i zero = _mm_setzero_si128();
+  for (int i = 0; i < 2; ++i) {
+    const __m128i low =
+        _mm_packs_epi32(_mm_srai_epi32(in[4 * i], hidden_shift),
+                        _mm_srai_epi32(in[4 * i + 1], hidden_shift));
+    const __m128i high =
+        _mm_packs_epi32(_mm_srai_epi32(in[4 * i + 2], hidden_shift),
+                        _mm_srai_epi32(in[4 * i + 3], hidden_shift));
+    out[i] = _mm_max_epi8(_mm_packs_epi16(low, high), zero);
+  }
+}
+
+__attribute__((target("avx2"))) void add_row_avx2(int16_t *accumulator,
+                                                  const int16_t *row) {
+  auto *acc = reinterpret_cast<__m256i *>(accumulator);
+  const auto *r = reinterpret_cast<const __m256i *>(row);
+  for (int i = 0; i < nnue_l1 / 16; ++i)
+    acc[i] = _mm256_add_epi16(acc[i], r[i]);
+}
+
+__attribute__((target("avx2"))) void sub_row_avx2(int16_t *accumulator,
+                                                  const int16_t *row) {
+  auto *acc = reinterpret_cast<__m256i *>(accumulator);
+  const auto *r = reinterpret_cast<const __m256i *>(row);
+  for (int i = 0; i < nnue_l1 / 16; ++i)
+    acc[i] = _mm256_sub_epi16(acc[i], r[i]);
+}
+
+__attribute__((target("avx2"))) void
+clip_accumulator_avx2(const int16_t *input, uint8_t *output) {
+  const auto *in = reinterpret_cast<const __m256i *>(input);
+  auto *out = reinterpret_cast<__m256i *>(output);
+  const __m256i zero = _mm256_setzero_si256();
+  for (int i = 0; i < nnue_l1 / 32; ++i) {
+    // packs works within 128 bit lanes: put the 64 bit quarters back in order
+    const __m256i packed = _mm256_packs_epi16(in[2 * i], in[2 * i + 1]);
+    out[i] = _mm256_max_epi8(_mm256_permute4x64_epi64(packed, 0xD8), zero);
+  }
+}
+
+__attribute__((target("avx2"))) void
+affine_avx2(const uint8_t *input, const int in_size, const int8_t *weights,
+            const int32_t *bias, int32_t *output, const int out_size) {
+  const auto *in = reinterpret_cast<const __m256i *>(input);
+  const __m256i ones = _mm256_set1_epi16(1);
+  for (int o = 0; o < out_size; ++o) {
+    const auto *row = reinterpret_cast<const __m256i *>(weights + o * in_size);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < in_size / 32; ++i) {
+      const __m256i products = _mm256_maddubs_epi16(in[i], row[i]);
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+    }
+    const __m128i halves = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                         _mm256_extracti128_si256(sum, 1));
+    output[o] = bias[o] + hsum_sse41(halves);
+  }
+}
+
+__attribute__((target("avx2"))) void clip_hidden_avx2(const int32_t *input,
+                                                      uint8_t *output) {
+  const auto *in = reinterpret_cast<const __m256i *>(input);
+  const __m256i low =
+      _mm256_packs_epi32(_mm256_srai_epi32(in[0], hidden_shift),
+                         _mm256_srai_epi32(in[1], hidden_shift));
+  const __m256i high =
+      _mm256_packs_epi32(_mm256_srai_epi32(in[2], hidden_shift),
+                         _mm256_srai_epi32(in[3], hidden_shift));
+  const __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(low, high),
+                                         _mm256_setzero_si256());
+  // both packs work within 128 bit lanes, which leaves the 32 bit groups of
+  // four outputs in the order 0 2 4 6 1 3 5 7
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  *reinterpret_cast<__m256i *>(output) =
+      _mm256_permutevar8x32_epi32(packed, order);
+}
+
+#endif
+
+SimdLevel detect_simd_level() {
+#ifdef STARFISH_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return SimdAvx2;
+  if (__builtin_cpu_supports("sse4.1"))
+    return SimdSse41;
+#endif
+  return SimdScalar;
+}
+
+const SimdLevel simd_level = detect_simd_level();
+
+Kernels make_kernels(const SimdLevel level) {
+#ifdef STARFISH_X86_KERNELS
+  if (level == SimdAvx2)
+    return {add_row_avx2, sub_row_avx2, clip_accumulator_avx2, affine_avx2,
+            clip_hidden_avx2};
+  if (level == SimdSse41)
+    return {add_row_sse41, sub_row_sse41, clip_accumulator_sse41, affine_sse41,
+            clip_hidden_sse41};
+#endif
+  (void)level;
+  return {add_row_scalar, sub_row_scalar, clip_accumulator_scalar,
+          affine_scalar, clip_hidden_scalar};
+}
+
+const Kernels kernels = make_kernels(simd_level);
+
+template <typename T>
+void fill_random(T *values, const size_t count, uint64_t &state,
+                 const int range) {
+  for (size_t i = 0; i < count; ++i)
+    values[i] = static_cast<T>(
+        static_cast<int>(zobrist_random(state) % (2 * range + 1)) - range);
+}
+
+} // namespace
+
+struct Network::Weights {
+  alignas(64) int16_t feature_bias[nnue_l1];
+  alignas(64) int16_t feature_weights[nnue_features][nnue_l1];
+  alignas(64) int32_t l1_bias[nnue_l2];
+  alignas(64) int8_t l1_weights[nnue_l2][2 * nnue_l1];
+  alignas(64) int32_t l2_bias[nnue_l3];
+  alignas(64) int8_t l2_weights[nnue_l3][nnue_l2];
+  alignas(64) int32_t output_bias[1];
+  alignas(64) int8_t output_weights[1][nnue_l3];
+
+  // every array in file order, for load and save
+  template <typename Visit> void for_each_array(const Visit &visit) {
+    visit(feature_bias, sizeof(feature_bias));
+    visit(feature_weights, sizeof(feature_weights));
+    visit(l1_bias, sizeof(l1_bias));
+    visit(l1_weights, sizeof(l1_weights));
+    visit(l2_bias, sizeof(l2_bias));
+    visit(l2_weights, sizeof(l2_weights));
+    visit(output_bias, sizeof(output_bias));
+    visit(output_weights, sizeof(output_weights));
+  }
+};
+
+SimdLevel get_simd_level() { return simd_level; }
+
+const char *simd_level_name(const SimdLevel level) {
+  switch (level) {
+  case SimdAvx2:
+    return "avx2";
+  case SimdSse41:
+    return "sse4.1";
+  case SimdScalar:
+    return "scalar";
+  }
+  return "unknown";
+}
+
+Network::Network() = default;
+Network::~Network() = default;
+
+bool Network::load(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  uint32_t header[std::size(file_header)];
+  if (!file.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+      std::memcmp(header, file_header, sizeof(header)) != 0)
+    return false;
+
+  auto loaded = std::make_unique<Weights>();
+  bool ok = true;
+  loaded->for_each_array([&](void *data, const size_t bytes) {
+    ok = ok && file.read(static_cast<char *>(data), bytes);
+  });
+  // and nothing after the last layer
+  if (!ok || file.peek() != std::ifstream::traits_type::eof())
+    return false;
+  weights = std::move(loaded);
+  generation++;
+  return true;
+}
+
+bool Network::save(const std::string &path) const {
+  if (!weights)
+    return false;
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(file_header), sizeof(file_header));
+  weights->for_each_array([&](const void *data, const size_t bytes) {
+    file.write(static_cast<const char *>(data), bytes);
+  });
+  return static_cast<bool>(file);
+}
+
+void Network::randomize(const uint64_t seed) {
+  auto random = std::make_unique<Weights>();
+  uint64_t state = seed;
+  fill_random(random->feature_bias, nnue_l1, state, 64);
+  fill_random(&random->feature_weights[0][0], size_t(nnue_features) * nnue_l1,
+              state, 8);
+  fill_random(random->l1_bias, nnue_l2, state, 1024);
+  fill_random(&random->l1_weights[0][0], size_t(nnue_l2) * 2 * nnue_l1, state,
+              16);
+  fill_random(random->l2_bias, nnue_l3, state, 1024);
+  fill_random(&random->l2_weights[0][0], size_t(nnue_l3) * nnue_l2, state,
+              32);
+  fill_random(random->output_bias, 1, state, 64);
+  fill_random(&random->output_weights[0][0], nnue_l3, state, 64);
+  weights = std::move(random);
+  generation++;
+}
+
+void Network::unload() {
+  weights.reset();
+  generation++;
+}
+
+int Network::feature_index(const colour_t perspective, const square_t king_sq,
+                           const piece_t piece, const square_t sq) {
+  assert(piece_type(piece) != King);
+  // black sees the board upside down, and its own pieces as the first five
+  const int flip = perspective == White ? 0 : 56;
+  const int relative_piece =
+      2 * piece_type(piece) + (piece_colour(piece) != perspective);
+  return ((king_sq ^ flip) * 10 + relative_piece) * 64 + (sq ^ flip);
+}
+
+void Network::refresh(Accumulator &accumulator, const colour_t perspective,
+                      const piece_t pieces[64]) const {
+  assert(weights);
+  int16_t *values = accumulator.values[colour_index(perspective)];
+  std::memcpy(values, weights->feature_bias, sizeof(weights->feature_bias));
+
+  const piece_t king = make_piece(perspective, King);
+  const square_t king_sq =
+      static_cast<square_t>(std::find(pieces, pieces + 64, king) - pieces);
+  assert(king_sq < 64);
+  for (square_t sq = 0; sq < 64; ++sq) {
+    if (pieces[sq] != InvalidPiece && piece_type(pieces[sq]) != King)
+      kernels.add_row(
+          values,
+          weights->feature_weights[feature_index(perspective, king_sq,
+                                                 pieces[sq], sq)]);
+  }
+}
+
+void Network::add_feature(Accumulator &accumulator, const colour_t perspective,
+                          const int feature) const {
+  kernels.add_row(accumulator.values[colour_index(perspective)],
+                  weights->feature_weights[feature]);
+}
+
+void Network::remove_feature(Accumulator &accumulator,
+                             const colour_t perspective,
+                             const int feature) const {
+  kernels.sub_row(accumulator.values[colour_index(perspective)],
+                  weights->feature_weights[feature]);
+}
+
+int Network::evaluate(const Accumulator &accumulator,
+                      const colour_t side_to_move) const {
+  assert(weights);
+  // the side to move's half goes first, so the network knows whose turn it is
+  alignas(64) uint8_t l1_input[2 * nnue_l1];
+  kernels.clip_accumulator(accumulator.values[colour_index(side_to_move)],
+                           l1_input);
+  kernels.clip_accumulator(accumulator.values[colour_index(-side_to_move)],
+                           l1_input + nnue_l1);
+
+  alignas(64) int32_t l1_output[nnue_l2];
+  alignas(64) uint8_t l2_input[nnue_l2];
+  kernels.affine(l1_input, 2 * nnue_l1, &weights->l1_weights[0][0],
+                 weights->l1_bias, l1_output, nnue_l2);
+  kernels.clip_hidden(l1_output, l2_input);
+
+  alignas(64) int32_t l2_output[nnue_l3];
+  alignas(64) uint8_t l3_input[nnue_l3];
+  kernels.affine(l2_input, nnue_l2, &weights->l2_weights[0][0],
+                 weights->l2_bias, l2_output, nnue_l3);
+  kernels.clip_hidden(l2_output, l3_input);
+
+  int32_t output;
+  kernels.affine(l3_input, nnue_l3, &weights->output_weights[0][0],
+                 weights->output_bias, &output, 1);
+  return output / output_scale;
+}
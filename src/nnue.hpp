@@ -0,0 +1,90 @@
+
+#pragma once
+
+#include "colour.hpp"
+#include "piece.hpp"
+#include "square.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// An efficiently updatable neural network evaluation (NNUE). The input layer
+// is HalfKP: for each side, one feature per (own king square, non-king piece,
+// square) triple, seen from that side with the ranks mirrored for black. Only
+// a few features change per move, so the first layer's output (the
+// accumulator) is updated from the pieces a move added and removed rather
+// than recomputed, except when a king moves and every feature of its side
+// changes.
+//
+//   HalfKP (40960 x 2) -> 256 x 2 -> 32 -> 32 -> 1
+//
+// The accumulator is int16. It is clipped to [0, 127] and fed through int8
+// dense layers, with each layer's int32 output scaled down and clipped back
+// to [0, 127]. The kernels are picked at start-up from AVX2, SSE4.1 and
+// plain C++ according to what the CPU supports.
+
+constexpr int nnue_features = 64 * 10 * 64;
+constexpr int nnue_l1 = 256;
+constexpr int nnue_l2 = 32;
+constexpr int nnue_l3 = 32;
+
+// the first layer's output for each side (by colour_index), before clipping
+struct Accumulator {
+  alignas(64) int16_t values[2][nnue_l1];
+};
+
+enum SimdLevel { SimdScalar, SimdSse41, SimdAvx2 };
+
+// the kernels evaluation runs on this machine
+SimdLevel get_simd_level();
+const char *simd_level_name(const SimdLevel level);
+
+class Network {
+public:
+  Network();
+  ~Network();
+  Network(const Network &) = delete;
+  Network &operator=(const Network &) = delete;
+
+  // Reads a network file: the magic "SFNN", a format version and the layer
+  // sizes (all uint32), then each layer's biases followed by its weights, all
+  // little endian. Returns false, keeping the current network, if the file
+  // can't be read or was written for other sizes.
+  bool load(const std::string &path);
+  bool save(const std::string &path) const;
+  // fills the network with small pseudo random weights: the evaluations are
+  // meaningless, but cost the same, which is all benchmarks need
+  void randomize(const uint64_t seed);
+  void unload();
+
+  inline bool is_loaded() const { return weights != nullptr; }
+  // changes whenever the weights do, so that accumulators computed with older
+  // weights can be told apart
+  inline uint32_t get_generation() const { return generation; }
+
+  // the input feature of a piece on sq, seen by perspective with its king on
+  // king_sq: the piece must not be a king
+  static int feature_index(const colour_t perspective, const square_t king_sq,
+                           const piece_t piece, const square_t sq);
+
+  // recomputes perspective's half of the accumulator from a mailbox
+  void refresh(Accumulator &accumulator, const colour_t perspective,
+               const piece_t pieces[64]) const;
+  void add_feature(Accumulator &accumulator, const colour_t perspective,
+                   const int feature) const;
+  void remove_feature(Accumulator &accumulator, const colour_t perspective,
+                      const int feature) const;
+
+  // the evaluation in centipawns for the side to move
+  int evaluate(const Accumulator &accumulator,
+               const colour_t side_to_move) const;
+
+private:
+  struct Weights;
+  std::unique_ptr<Weights> weights;
+  uint32_t generation = 0;
+};
+
+// the network Board keeps its accumulator for: empty until something loads it
+extern Network nnue_network;
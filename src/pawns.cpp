@@ -0,0 +1,173 @@
+
+#include "pawns.hpp"
+
+#include "board.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+// indexed by the pawn's rank counted from its own side, so the second rank is
+// 1 and the seventh 6
+constexpr Score passed_bonus[8] = {{0, 0},   {0, 5},   {5, 10},  {10, 20},
+                                   {20, 40}, {35, 65}, {60, 100}, {0, 0}};
+constexpr Score isolated_penalty = {-10, -15};
+// for each pawn with another pawn of its own in front of it
+constexpr Score doubled_penalty = {-10, -20};
+// a pawn behind all its neighbours which cannot advance without being taken
+constexpr Score backward_penalty = {-8, -12};
+// for each pawn in front of the king, one and two ranks ahead: middlegame
+// only, since the king should come out once the pieces are off
+constexpr Score shield_bonus[2] = {{15, 0}, {8, 0}};
+
+// the squares ahead of sq, as seen by side, on the files in files
+constexpr bitboard_t make_span(const colour_t side, const square_t sq,
+                               const bitboard_t files) {
+  bitboard_t span = 0;
+  for (square_t other = 0; other < 64; ++other) {
+    const int ahead = (square_rank(other) - square_rank(sq)) * side;
+    if (ahead > 0 && (files & square_bb(other)))
+      span |= square_bb(other);
+  }
+  return span;
+}
+
+constexpr bitboard_t file_bb(const int file) { return file_a_bb << file; }
+
+constexpr bitboard_t adjacent_files_bb(const int file) {
+  return (file > 0 ? file_bb(file - 1) : 0) |
+         (file < 7 ? file_bb(file + 1) : 0);
+}
+
+struct SpanTables {
+  // indexed by colour_index and square: ahead on the same file, ahead on the
+  // same and adjacent files, and ahead on the adjacent files only
+  bitboard_t forward_file[2][64] = {};
+  bitboard_t passed_span[2][64] = {};
+  bitboard_t attack_span[2][64] = {};
+};
+
+constexpr SpanTables make_span_tables() {
+  SpanTables tables{};
+  for (const colour_t side : {White, Black}) {
+    for (square_t sq = 0; sq < 64; ++sq) {
+      const int file = square_file(sq);
+      const int i = colour_index(side);
+      tables.forward_file[i][sq] = make_span(side, sq, file_bb(file));
+      tables.attack_span[i][sq] = make_span(side, sq, adjacent_files_bb(file));
+      tables.passed_span[i][sq] =
+          tables.forward_file[i][sq] | tables.attack_span[i][sq];
+    }
+  }
+  return tables;
+}
+
+constexpr SpanTables span_tables = make_span_tables();
+
+inline void add_score(Score &score, const colour_t side, const Score bonus) {
+  if (side == White)
+    score += bonus;
+  else
+    score -= bonus;
+}
+
+// the pawn structure of one side, white relative
+void evaluate_side(const Board &board, const colour_t us, PawnEntry &entry) {
+  const colour_t them = -us;
+  const int i = colour_index(us);
+  const bitboard_t ours = board.get_piece_bb(make_piece(us, Pawn));
+  const bitboard_t theirs = board.get_piece_bb(make_piece(them, Pawn));
+
+  bitboard_t attacks = 0;
+  bitboard_t their_attacks = 0;
+  for (bitboard_t bb = theirs; bb;)
+    their_attacks |= pawn_attacks_bb(pop_lsb(bb), them);
+
+  for (bitboard_t bb = ours; bb;) {
+    const square_t sq = pop_lsb(bb);
+    const bitboard_t neighbours = ours & adjacent_files_bb(square_file(sq));
+    attacks |= pawn_attacks_bb(sq, us);
+    entry.attack_span[i] |= span_tables.attack_span[i][sq];
+
+    if (!(theirs & span_tables.passed_span[i][sq])) {
+      entry.passed[i] |= square_bb(sq);
+      const int rank = us == White ? square_rank(sq) : 7 - square_rank(sq);
+      add_score(entry.score, us, passed_bonus[rank]);
+    }
+    if (ours & span_tables.forward_file[i][sq])
+      add_score(entry.score, us, doubled_penalty);
+    if (!neighbours) {
+      add_score(entry.score, us, isolated_penalty);
+    } else if (!(neighbours & ~span_tables.attack_span[i][sq]) &&
+               (their_attacks & square_bb(sq - 8 * us))) {
+      // every neighbour is ahead, so none can come up to protect the stop
+      // square, which an enemy pawn guards
+      add_score(entry.score, us, backward_penalty);
+    }
+  }
+  entry.attacks[i] = attacks;
+}
+
+// the shield of the king of side us on king_sq, white relative
+Score evaluate_shield(const Board &board, const colour_t us,
+                      const square_t king_sq) {
+  Score score;
+  const bitboard_t ours = board.get_piece_bb(make_piece(us, Pawn));
+  const int file = square_file(king_sq);
+  for (int ahead = 1; ahead <= 2; ++ahead) {
+    const int rank = square_rank(king_sq) + ahead * us;
+    if (rank < 0 || rank > 7)
+      break;
+    for (int f = std::max(file - 1, 0); f <= std::min(file + 1, 7); ++f) {
+      if (ours & square_bb(square_from_file_rank(f, rank)))
+        add_score(score, us, shield_bonus[ahead - 1]);
+    }
+  }
+  return score;
+}
+
+} // namespace
+
+PawnEntry evaluate_pawns(const Board &board) {
+  PawnEntry entry;
+  entry.key = board.get_pawn_hash();
+  for (const colour_t side : {White, Black}) {
+    evaluate_side(board, side, entry);
+    const int i = colour_index(side);
+    entry.king_squares[i] = board.get_king_square(side);
+    entry.shield[i] = evaluate_shield(board, side, entry.king_squares[i]);
+  }
+  return entry;
+}
+
+PawnHashTable::PawnHashTable(const size_t size) : entries(size) {
+  // probe masks the key
+  assert(size && (size & (size - 1)) == 0);
+}
+
+const PawnEntry &PawnHashTable::probe(const Board &board) {
+  const uint64_t key = board.get_pawn_hash();
+  PawnEntry &entry = entries[key & (entries.size() - 1)];
+  if (entry.key != key) {
+    entry = evaluate_pawns(board);
+    return entry;
+  }
+
+  for (const colour_t side : {White, Black}) {
+    const int i = colour_index(side);
+    const square_t king_sq = board.get_king_square(side);
+    if (entry.king_squares[i] != king_sq) {
+      entry.king_squares[i] = king_sq;
+      entry.shield[i] = evaluate_shield(board, side, king_sq);
+    }
+  }
+#ifndef NDEBUG
+  const PawnEntry fresh = evaluate_pawns(board);
+  assert(fresh.score == entry.score && fresh.shield[0] == entry.shield[0] &&
+         fresh.shield[1] == entry.shield[1]);
+  assert(fresh.passed[0] == entry.passed[0] &&
+         fresh.passed[1] == entry.passed[1]);
+#endif
+  return entry;
+}
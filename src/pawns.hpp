@@ -0,0 +1,50 @@
+
+#pragma once
+
+#include "bitboard.hpp"
+#include "psqt.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class Board;
+
+// What the pawns alone say about a position: the pawn-structure score and the
+// bitboards worked out on the way, indexed by colour_index. Pawns move far
+// less often than anything else, so these are cached by the pawn key.
+struct PawnEntry {
+  uint64_t key = 0;
+  // passed, isolated, doubled and backward pawns, white relative
+  Score score;
+  // pawns with no enemy pawn in front of them on their own or an adjacent file
+  bitboard_t passed[2] = {};
+  // squares the pawns attack
+  bitboard_t attacks[2] = {};
+  // squares the pawns attack or could attack as they advance
+  bitboard_t attack_span[2] = {};
+
+  // the pawn shield in front of each king, white relative, which also depends
+  // on where the king is: it is kept for the king squares it was worked out
+  // for and redone when a king has moved
+  square_t king_squares[2] = {InvalidSquare, InvalidSquare};
+  Score shield[2];
+};
+
+// A per-thread cache of PawnEntry, keyed on Board::get_pawn_hash(). Nothing
+// in an entry depends on the search, so the table never needs clearing. The
+// default entry is right for a position without pawns, whose key is 0.
+class PawnHashTable {
+  std::vector<PawnEntry> entries;
+
+public:
+  constexpr static size_t default_entries = 16384;
+
+  explicit PawnHashTable(const size_t size = default_entries);
+
+  // the entry of the board's pawns, evaluating them on a miss, with the
+  // shields up to date for the board's kings
+  const PawnEntry &probe(const Board &board);
+};
+
+// the pawn structure and shields of a position, evaluated from scratch
+PawnEntry evaluate_pawns(const Board &board);
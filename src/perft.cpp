@@ -0,0 +1,157 @@
+
+#include "perft.hpp"
+
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <ctime>
+
+PerftTable::PerftTable(const size_t mb) {
+  size_t count = 1;
+  while (2 * count * sizeof(Entry) <= (mb << 20))
+    count *= 2;
+  entries = std::make_unique<Entry[]>(count);
+  mask = count - 1;
+}
+
+bool PerftTable::probe(const uint64_t key, const int depth,
+                       uint64_t &nodes) const {
+  const uint64_t k = depth_key(key, depth);
+  const Entry &entry = entries[k & mask];
+  const uint64_t stored = entry.nodes.load(std::memory_order_relaxed);
+  const uint64_t check = entry.check.load(std::memory_order_relaxed);
+  if ((check ^ stored) != k || stored == 0)
+    return false;
+  nodes = stored;
+  return true;
+}
+
+void PerftTable::store(const uint64_t key, const int depth,
+                       const uint64_t nodes) {
+  const uint64_t k = depth_key(key, depth);
+  Entry &entry = entries[k & mask];
+  entry.nodes.store(nodes, std::memory_order_relaxed);
+  entry.check.store(k ^ nodes, std::memory_order_relaxed);
+}
+
+uint64_t perft(Board &board, const int depth, PerftTable *table) {
+  if (depth <= 0)
+    return 1;
+
+  MoveList moves;
+  board.generate<Legal>(moves);
+  if (depth == 1)
+    return moves.size();
+
+  uint64_t nodes = 0;
+  if (table && table->probe(board.get_hash(), depth, nodes))
+    return nodes;
+
+  for (const PackedMove move : moves) {
+    board.make_move(move);
+    nodes += perft(board, depth - 1, table);
+    board.unmake_move();
+  }
+
+  if (table)
+    table->store(board.get_hash(), depth, nodes);
+  return nodes;
+}
+
+std::vector<std::pair<PackedMove, uint64_t>>
+perft_divide(Board &board, const int depth, PerftTable *table) {
+  std::vector<std::pair<PackedMove, uint64_t>> result;
+  MoveList moves;
+  board.generate<Legal>(moves);
+  for (const PackedMove move : moves) {
+    board.make_move(move);
+    result.emplace_back(move, perft(board, depth - 1, table));
+    board.unmake_move();
+  }
+  return result;
+}
+
+namespace {
+
+// CPU time used by the calling thread: unlike wall time, this doesn't count
+// time spent waiting for a core when there are more threads than cores
+double thread_cpu_seconds() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+} // namespace
+
+ParallelPerftResult parallel_perft(const Board &board, const int depth,
+                                   const int threads, PerftTable *table) {
+  using Clock = std::chrono::steady_clock;
+  const auto start = Clock::now();
+
+  ParallelPerftResult result;
+  result.thread_nodes.assign(threads, 0);
+  result.thread_seconds.assign(threads, 0);
+  if (depth <= 0) {
+    result.nodes = 1;
+    return result;
+  }
+
+  Board root(board);
+  MoveList root_moves;
+  root.generate<Legal>(root_moves);
+
+  // one task per reply to each root move: below depth 2 there is too little
+  // work to be worth splitting, so the root move is its own task
+  struct Task {
+    int root_index;
+    PackedMove root_move;
+    PackedMove reply;
+    uint64_t nodes;
+  };
+  std::vector<Task> tasks;
+  for (int i = 0; i < root_moves.size(); ++i) {
+    const PackedMove move = root_moves[i];
+    result.divide.emplace_back(move, 0);
+    if (depth <= 2) {
+      tasks.push_back({i, move, PackedMove::none(), 0});
+      continue;
+    }
+    root.make_move(move);
+    MoveList replies;
+    root.generate<Legal>(replies);
+    for (const PackedMove reply : replies)
+      tasks.push_back({i, move, reply, 0});
+    root.unmake_move();
+  }
+
+  std::vector<Board> boards(threads, board);
+  {
+    ThreadPool pool(threads);
+    for (Task &task : tasks) {
+      pool.submit([&, depth](const int worker) {
+        const double task_start = thread_cpu_seconds();
+        Board &b = boards[worker];
+        b.make_move(task.root_move);
+        if (task.reply == PackedMove::none()) {
+          task.nodes = perft(b, depth - 1, table);
+        } else {
+          b.make_move(task.reply);
+          task.nodes = perft(b, depth - 2, table);
+          b.unmake_move();
+        }
+        b.unmake_move();
+        // only this worker touches its own slots
+        result.thread_nodes[worker] += task.nodes;
+        result.thread_seconds[worker] += thread_cpu_seconds() - task_start;
+      });
+    }
+    pool.wait();
+  }
+
+  for (const Task &task : tasks) {
+    result.divide[task.root_index].second += task.nodes;
+    result.nodes += task.nodes;
+  }
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return result;
+}
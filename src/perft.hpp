@@ -0,0 +1,62 @@
+
+#pragma once
+
+#include "board.hpp"
+#include "move.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Caches subtree node counts keyed on (position, depth). Entries use the same
+// lockless XOR trick as the transposition table, so several threads can share
+// one table.
+class PerftTable {
+  struct Entry {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> nodes;
+  };
+  std::unique_ptr<Entry[]> entries;
+  size_t mask;
+
+  // a different key per depth, so counts to different depths never collide
+  static inline uint64_t depth_key(const uint64_t key, const int depth) {
+    return key ^ (static_cast<uint64_t>(depth) * 0x9E3779B97F4A7C15ULL);
+  }
+
+public:
+  // allocates the largest power of two number of entries that fits in mb
+  explicit PerftTable(const size_t mb);
+
+  bool probe(const uint64_t key, const int depth, uint64_t &nodes) const;
+  void store(const uint64_t key, const int depth, const uint64_t nodes);
+};
+
+// counts the leaves of the legal move tree depth plies deep; the last ply is
+// counted from the move list rather than played (bulk counting)
+uint64_t perft(Board &board, const int depth, PerftTable *table = nullptr);
+
+// perft split by root move, in generation order
+std::vector<std::pair<PackedMove, uint64_t>>
+perft_divide(Board &board, const int depth, PerftTable *table = nullptr);
+
+struct ParallelPerftResult {
+  // per root move, in generation order
+  std::vector<std::pair<PackedMove, uint64_t>> divide;
+  uint64_t nodes = 0;
+  double seconds = 0;
+  // nodes searched and CPU time spent by each worker thread
+  std::vector<uint64_t> thread_nodes;
+  std::vector<double> thread_seconds;
+};
+
+// perft over a work-stealing pool: the tree is split into one task per
+// (root move, reply) pair, each worker plays them on its own copy of the
+// board, and the counts are summed in task order so they always match the
+// single threaded perft. The table, if given, is shared by all workers.
+ParallelPerftResult parallel_perft(const Board &board, const int depth,
+                                   const int threads,
+                                   PerftTable *table = nullptr);
@@ -0,0 +1,136 @@
+
+#include "board.hpp"
+#include "perft.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace {
+
+void print_usage(const char *program) {
+  std::cerr << "usage: " << program
+            << " <depth> [fen] [--divide] [--hash <mb>] [--threads <n>]\n"
+               "  --divide       print the node count below each root move\n"
+               "  --hash <mb>    cache subtree counts in an mb megabyte table\n"
+               "  --threads <n>  split the tree over n threads\n";
+}
+
+// a whole argument holding a non-negative number
+template <typename T> bool parse_number(const std::string_view arg, T &value) {
+  const char *end = arg.data() + arg.size();
+  const auto [parsed_end, error] = std::from_chars(arg.data(), end, value);
+  return !arg.empty() && error == std::errc() && parsed_end == end &&
+         value >= 0;
+}
+
+void report(const uint64_t nodes, const double seconds) {
+  std::cout << "Nodes: " << nodes << "\n"
+            << "Time: " << static_cast<int64_t>(seconds * 1000) << " ms\n"
+            << "NPS: " << static_cast<int64_t>(nodes / std::max(seconds, 1e-9))
+            << std::endl;
+}
+
+void report_parallel(const ParallelPerftResult &result) {
+  double cpu_seconds = 0;
+  for (size_t i = 0; i < result.thread_nodes.size(); ++i) {
+    const double seconds = result.thread_seconds[i];
+    cpu_seconds += seconds;
+    std::cout << "Thread " << i << ": " << result.thread_nodes[i]
+              << " nodes, cpu " << static_cast<int64_t>(seconds * 1000)
+              << " ms, NPS "
+              << static_cast<int64_t>(result.thread_nodes[i] /
+                                      std::max(seconds, 1e-9))
+              << "\n";
+  }
+  report(result.nodes, result.seconds);
+
+  // how many threads' worth of CPU time went into each second of wall time,
+  // and what fraction of the threads that is. This is how busy the threads
+  // were, not a speedup: compare with a --threads 1 run for that.
+  const double busy_threads = cpu_seconds / std::max(result.seconds, 1e-9);
+  std::cout << "CPU utilisation: " << busy_threads << " threads ("
+            << 100 * busy_threads /
+                   static_cast<double>(result.thread_nodes.size())
+            << "%)" << std::endl;
+}
+
+} // namespace
+
+// Counts the legal move tree of a position and reports how fast it went: the
+// nodes/second printed here is the yardstick for move generation changes.
+int main(int argc, char *argv[]) {
+  int depth = -1;
+  std::string fen;
+  bool divide = false;
+  size_t hash_mb = 0;
+  int threads = 1;
+
+  bool ok = true;
+  for (int i = 1; i < argc && ok; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--divide") {
+      divide = true;
+    } else if (arg == "--hash") {
+      ok = i + 1 < argc && parse_number(argv[++i], hash_mb);
+    } else if (arg == "--threads") {
+      ok = i + 1 < argc && parse_number(argv[++i], threads) && threads > 0;
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      // an unknown option: a lone "-" is an empty FEN field
+      ok = false;
+    } else if (depth < 0) {
+      ok = parse_number(arg, depth);
+    } else {
+      fen += (fen.empty() ? "" : " ") + arg;
+    }
+  }
+  if (!ok || depth < 0) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  Board board;
+  if (!fen.empty()) {
+    const FenError error = board.set_fen(fen);
+    if (error != FenOk) {
+      std::cerr << "bad fen: " << fen_error_message(error) << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::unique_ptr<PerftTable> table;
+  if (hash_mb > 0)
+    table = std::make_unique<PerftTable>(hash_mb);
+
+  if (threads > 1) {
+    const ParallelPerftResult result =
+        parallel_perft(board, depth, threads, table.get());
+    if (divide) {
+      for (const auto &[move, count] : result.divide)
+        std::cout << move.to_uci() << ": " << count << "\n";
+      std::cout << "\n";
+    }
+    report_parallel(result);
+    return EXIT_SUCCESS;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  uint64_t nodes = 0;
+  if (divide) {
+    for (const auto &[move, count] : perft_divide(board, depth, table.get())) {
+      std::cout << move.to_uci() << ": " << count << "\n";
+      nodes += count;
+    }
+    std::cout << "\n";
+  } else {
+    nodes = perft(board, depth, table.get());
+  }
+  report(nodes, std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count());
+}
@@ -44,3 +44,19 @@ constexpr colour_t piece_colour(const piece_t piece) {
     return InvalidColour;
   return (piece < 8) ? White : Black;
 }
+
+// the colourless kind of a piece: a piece is its type, plus 8 if it is black
+enum PieceType {
+  Pawn = 0,
+  Knight = 1,
+  Bishop = 2,
+  Rook = 3,
+  Queen = 4,
+  King = 5,
+};
+
+constexpr int piece_type(const piece_t piece) { return piece & 7; }
+
+constexpr piece_t make_piece(const colour_t colour, const int type) {
+  return colour == White ? type : type + 8;
+}
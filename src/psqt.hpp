@@ -0,0 +1,175 @@
+
+#pragma once
+
+#include "piece.hpp"
+#include "square.hpp"
+
+#include <algorithm>
+
+// Tapered material and piece-square evaluation: every (piece, square) pair is
+// worth a middlegame and an endgame score from white's point of view, and a
+// position's score is the sum over its pieces, blended by how much material is
+// left. Board keeps the sum and the phase up to date as pieces move, so
+// evaluating them costs nothing.
+
+// a middlegame and an endgame value, in centipawns
+struct Score {
+  int mg = 0;
+  int eg = 0;
+
+  constexpr Score operator+(const Score other) const {
+    return {mg + other.mg, eg + other.eg};
+  }
+  constexpr Score operator-(const Score other) const {
+    return {mg - other.mg, eg - other.eg};
+  }
+  constexpr Score operator-() const { return {-mg, -eg}; }
+  constexpr Score &operator+=(const Score other) {
+    mg += other.mg;
+    eg += other.eg;
+    return *this;
+  }
+  constexpr Score &operator-=(const Score other) {
+    mg -= other.mg;
+    eg -= other.eg;
+    return *this;
+  }
+  constexpr bool operator==(const Score other) const {
+    return mg == other.mg && eg == other.eg;
+  }
+  constexpr bool operator!=(const Score other) const {
+    return !(*this == other);
+  }
+};
+
+// how much each piece type counts towards the middlegame: the starting
+// position adds up to max_phase, bare kings to 0
+constexpr int phase_weights[6] = {0, 1, 1, 2, 4, 0};
+constexpr int max_phase = 24;
+
+// blends a score by phase, which can exceed max_phase after promotions
+constexpr int taper(const Score score, const int phase) {
+  const int mg_phase = std::min(phase, max_phase);
+  return (score.mg * mg_phase + score.eg * (max_phase - mg_phase)) /
+         max_phase;
+}
+
+// piece values by PieceType
+constexpr Score material_values[6] = {
+    {100, 120}, {320, 300}, {330, 320}, {500, 530}, {900, 950}, {0, 0}};
+
+// The piece-square bonuses for white pieces, laid out as the board is printed
+// (a8 first). Black's come from mirroring the ranks. The values follow Tomasz
+// Michniewski's simplified evaluation function, with endgame tables of their
+// own only for the pawn and the king, whose jobs change the most.
+// clang-format off
+constexpr int pawn_mg[64] = {
+    0,   0,   0,   0,   0,   0,   0,   0,
+   50,  50,  50,  50,  50,  50,  50,  50,
+   10,  10,  20,  30,  30,  20,  10,  10,
+    5,   5,  10,  25,  25,  10,   5,   5,
+    0,   0,   0,  20,  20,   0,   0,   0,
+    5,  -5, -10,   0,   0, -10,  -5,   5,
+    5,  10,  10, -20, -20,  10,  10,   5,
+    0,   0,   0,   0,   0,   0,   0,   0
+};
+constexpr int pawn_eg[64] = {
+    0,   0,   0,   0,   0,   0,   0,   0,
+   80,  80,  80,  80,  80,  80,  80,  80,
+   50,  50,  50,  50,  50,  50,  50,  50,
+   30,  30,  30,  30,  30,  30,  30,  30,
+   15,  15,  15,  15,  15,  15,  15,  15,
+    5,   5,   5,   5,   5,   5,   5,   5,
+    0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0
+};
+constexpr int knight_psq[64] = {
+  -50, -40, -30, -30, -30, -30, -40, -50,
+  -40, -20,   0,   0,   0,   0, -20, -40,
+  -30,   0,  10,  15,  15,  10,   0, -30,
+  -30,   5,  15,  20,  20,  15,   5, -30,
+  -30,   0,  15,  20,  20,  15,   0, -30,
+  -30,   5,  10,  15,  15,  10,   5, -30,
+  -40, -20,   0,   5,   5,   0, -20, -40,
+  -50, -40, -30, -30, -30, -30, -40, -50
+};
+constexpr int bishop_psq[64] = {
+  -20, -10, -10, -10, -10, -10, -10, -20,
+  -10,   0,   0,   0,   0,   0,   0, -10,
+  -10,   0,   5,  10,  10,   5,   0, -10,
+  -10,   5,   5,  10,  10,   5,   5, -10,
+  -10,   0,  10,  10,  10,  10,   0, -10,
+  -10,  10,  10,  10,  10,  10,  10, -10,
+  -10,   5,   0,   0,   0,   0,   5, -10,
+  -20, -10, -10, -10, -10, -10, -10, -20
+};
+constexpr int rook_psq[64] = {
+    0,   0,   0,   0,   0,   0,   0,   0,
+    5,  10,  10,  10,  10,  10,  10,   5,
+   -5,   0,   0,   0,   0,   0,   0,  -5,
+   -5,   0,   0,   0,   0,   0,   0,  -5,
+   -5,   0,   0,   0,   0,   0,   0,  -5,
+   -5,   0,   0,   0,   0,   0,   0,  -5,
+   -5,   0,   0,   0,   0,   0,   0,  -5,
+    0,   0,   0,   5,   5,   0,   0,   0
+};
+constexpr int queen_psq[64] = {
+  -20, -10, -10,  -5,  -5, -10, -10, -20,
+  -10,   0,   0,   0,   0,   0,   0, -10,
+  -10,   0,   5,   5,   5,   5,   0, -10,
+   -5,   0,   5,   5,   5,   5,   0,  -5,
+    0,   0,   5,   5,   5,   5,   0,  -5,
+  -10,   5,   5,   5,   5,   5,   0, -10,
+  -10,   0,   5,   0,   0,   0,   0, -10,
+  -20, -10, -10,  -5,  -5, -10, -10, -20
+};
+constexpr int king_mg[64] = {
+  -30, -40, -40, -50, -50, -40, -40, -30,
+  -30, -40, -40, -50, -50, -40, -40, -30,
+  -30, -40, -40, -50, -50, -40, -40, -30,
+  -30, -40, -40, -50, -50, -40, -40, -30,
+  -20, -30, -30, -40, -40, -30, -30, -20,
+  -10, -20, -20, -20, -20, -20, -20, -10,
+   20,  20,   0,   0,   0,   0,  20,  20,
+   20,  30,  10,   0,   0,  10,  30,  20
+};
+constexpr int king_eg[64] = {
+  -50, -40, -30, -20, -20, -30, -40, -50,
+  -30, -20, -10,   0,   0, -10, -20, -30,
+  -30, -10,  20,  30,  30,  20, -10, -30,
+  -30, -10,  30,  40,  40,  30, -10, -30,
+  -30, -10,  30,  40,  40,  30, -10, -30,
+  -30, -10,  20,  30,  30,  20, -10, -30,
+  -30, -30,   0,   0,   0,   0, -30, -30,
+  -50, -30, -30, -30, -30, -30, -30, -50
+};
+// clang-format on
+
+// indexed by piece_t and square: material plus placement, negative for black
+struct PsqtTable {
+  Score scores[16][64] = {};
+  int phases[16] = {};
+};
+
+constexpr PsqtTable make_psqt_table() {
+  const int *mg_tables[6] = {pawn_mg,  knight_psq, bishop_psq,
+                             rook_psq, queen_psq,  king_mg};
+  const int *eg_tables[6] = {pawn_eg,  knight_psq, bishop_psq,
+                             rook_psq, queen_psq,  king_eg};
+  PsqtTable table{};
+  for (int type = Pawn; type <= King; ++type) {
+    const piece_t white = make_piece(White, type);
+    const piece_t black = make_piece(Black, type);
+    table.phases[white] = table.phases[black] = phase_weights[type];
+    for (square_t sq = 0; sq < 64; ++sq) {
+      const Score score = material_values[type] +
+                          Score{mg_tables[type][sq], eg_tables[type][sq]};
+      table.scores[white][sq] = score;
+      // sq ^ 56 is the same square seen from the other side of the board
+      table.scores[black][sq ^ 56] = -score;
+    }
+  }
+  return table;
+}
+
+constexpr PsqtTable psqt_table = make_psqt_table();
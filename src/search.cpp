@@ -0,0 +1,509 @@
+
+#include "search.hpp"
+
+#include "move_picker.hpp"
+#include "nnue.hpp"
+#include "tt.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+namespace {
+
+// how far either side of the previous score the first aspiration window
+// reaches, in centipawns
+constexpr int aspiration_delta = 25;
+constexpr int aspiration_min_depth = 4;
+// how much more than the captured piece a capture in the quiescence search
+// might still win positionally: beyond that it can't raise alpha
+constexpr int delta_margin = 200;
+// the most one cutoff changes a history score by
+constexpr int max_history_bonus = 1600;
+
+// which depths the helper threads search: helper i skips runs of
+// skip_size[i] depths, offset by skip_phase[i], so that at any time the
+// threads are spread over the next few depths
+constexpr int skip_patterns = 20;
+constexpr int skip_size[skip_patterns] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                          3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+constexpr int skip_phase[skip_patterns] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3,
+                                           4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+// mate scores are stored relative to the node rather than the root, so that an
+// entry stays right when the position is reached at a different ply
+int score_to_tt(const int score, const int ply) {
+  return score >= mate_bound    ? score + ply
+         : score <= -mate_bound ? score - ply
+                                : score;
+}
+
+int score_from_tt(const int score, const int ply) {
+  return score >= mate_bound    ? score - ply
+         : score <= -mate_bound ? score + ply
+                                : score;
+}
+
+} // namespace
+
+void print_info(std::ostream &out, const SearchInfo &info) {
+  out << "info depth " << info.depth << " seldepth " << info.seldepth
+      << " score ";
+  if (is_mate_score(info.score)) {
+    // in moves rather than plies, negative when we are being mated
+    const int plies = mate_score - std::abs(info.score);
+    out << "mate " << (info.score > 0 ? (plies + 1) / 2 : -(plies / 2));
+  } else {
+    out << "cp " << info.score;
+  }
+  out << " nodes " << info.nodes << " nps " << info.nps << " hashfull "
+      << tt.hashfull() << " time " << info.time_ms << " pv";
+  for (const PackedMove move : info.pv)
+    out << " " << move.to_uci();
+  out << std::endl;
+}
+
+Search::Search(SearchPool &pool, const int thread_index)
+    : pool(pool), thread_index(thread_index) {
+  clear();
+}
+
+void Search::clear() {
+  history.clear();
+  std::fill(&killers[0][0], &killers[0][0] + (max_ply + 1) * 2,
+            PackedMove::none());
+  std::fill(&counter_moves[0][0], &counter_moves[0][0] + 16 * 64,
+            PackedMove::none());
+}
+
+SearchResult Search::run(const Board &new_board, const SearchLimits &new_limits,
+                         const InfoCallback &on_info) {
+  board = new_board;
+  limits = new_limits;
+  nodes.store(0, std::memory_order_relaxed);
+  stats = SearchStats();
+
+  SearchResult result;
+  const MoveList legal_moves = board.generate_legal_moves();
+  if (legal_moves.size() == 0) {
+    result.score = board.in_check() ? -mate_score : 0;
+    return result;
+  }
+  // something to play even if the first iteration is cut short
+  result.best_move = legal_moves[0];
+
+  int score = 0;
+  const int max_depth = std::min(limits.depth, max_ply - 1);
+  for (int depth = 1; depth <= max_depth && !pool.is_stopped(); ++depth) {
+    if (skip_depth(depth))
+      continue;
+    root_depth = depth;
+    seldepth = 0;
+    score = aspiration_search(depth, score);
+    // an unfinished iteration is thrown away
+    if (aborted())
+      break;
+
+    result.best_move = pv[0][0];
+    result.ponder_move = pv_length[0] > 1 ? pv[0][1] : PackedMove::none();
+    result.score = score;
+    result.depth = depth;
+
+    if (on_info) {
+      const uint64_t total_nodes = pool.get_nodes();
+      const int64_t time_ms = pool.elapsed_ms();
+      SearchInfo info{depth,
+                      seldepth,
+                      score,
+                      total_nodes,
+                      time_ms,
+                      total_nodes * 1000 / static_cast<uint64_t>(time_ms + 1),
+                      std::vector<PackedMove>(pv[0], pv[0] + pv_length[0]),
+                      stats};
+      on_info(info);
+    }
+
+    // the main thread decides whether there is time for another iteration;
+    // while pondering the clock isn't ours yet
+    if (thread_index == 0 &&
+        pool.get_time_manager().stop_after_iteration(
+            depth, score, result.best_move, pool.elapsed_ms()) &&
+        !pool.is_pondering())
+      pool.stop();
+  }
+  result.nodes = get_nodes();
+  return result;
+}
+
+int Search::aspiration_search(const int depth, const int previous_score) {
+  int delta = aspiration_delta;
+  int alpha = -infinite_score;
+  int beta = infinite_score;
+  if (depth >= aspiration_min_depth && !is_mate_score(previous_score)) {
+    alpha = std::max(previous_score - delta, -infinite_score);
+    beta = std::min(previous_score + delta, infinite_score);
+  }
+
+  while (true) {
+    const int score = negamax(alpha, beta, depth, 0);
+    if (aborted())
+      return score;
+    // on a fail low also pull beta in, as the score is probably lower than
+    // we thought
+    if (score <= alpha) {
+      beta = (alpha + beta) / 2;
+      alpha = std::max(score - delta, -infinite_score);
+    } else if (score >= beta) {
+      beta = std::min(score + delta, infinite_score);
+    } else {
+      return score;
+    }
+    delta *= 2;
+  }
+}
+
+int Search::negamax(int alpha, int beta, int depth, const int ply) {
+  const bool pv_node = beta - alpha > 1;
+  pv_length[ply] = ply;
+  nodes.store(nodes.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+  seldepth = std::max(seldepth, ply);
+
+  if (ply > 0 && should_stop())
+    return 0;
+
+  if (ply > 0 && board.is_draw(ply))
+    return 0;
+
+  const bool in_check = board.in_check();
+  // look one ply further at checks, which are forcing
+  if (in_check)
+    depth++;
+  if (ply >= max_ply)
+    return evaluate();
+  if (depth <= 0)
+    return quiescence(alpha, beta, ply);
+
+  const uint64_t key = board.get_hash();
+  TTData tt_data{};
+  const bool tt_hit = tt.probe(key, tt_data);
+  if (tt_hit && !pv_node && tt_data.depth >= depth) {
+    const int tt_score = score_from_tt(tt_data.score, ply);
+    if (tt_data.bound == BoundExact ||
+        (tt_data.bound == BoundLower && tt_score >= beta) ||
+        (tt_data.bound == BoundUpper && tt_score <= alpha))
+      return tt_score;
+  }
+  // nothing here prunes on the static evaluation, so it isn't computed: the
+  // table keeps one a quiescence search has already stored
+  const int static_eval = tt_hit && !in_check ? tt_data.eval : no_eval;
+
+  const PackedMove last_move = board.get_last_move();
+  const PackedMove counter_move =
+      last_move == PackedMove::none()
+          ? PackedMove::none()
+          : counter_moves[board.get_piece(last_move.to())][last_move.to()];
+  MovePicker picker(board, tt_hit ? tt_data.move : PackedMove::none(),
+                    killers[ply][0], killers[ply][1], counter_move, &history);
+  int best_score = -infinite_score;
+  PackedMove best_move = PackedMove::none();
+  int move_count = 0;
+  // the quiet moves searched without causing a cutoff
+  MoveList quiets_tried;
+
+  PackedMove move;
+  while ((move = picker.next_move()) != PackedMove::none()) {
+    if (!board.is_legal(move))
+      continue;
+    const bool quiet = !move.is_capture() && !move.is_promotion();
+    board.make_move(move);
+    move_count++;
+
+    int score;
+    if (move_count == 1) {
+      score = -negamax(-beta, -alpha, depth - 1, ply + 1);
+    } else {
+      // prove the move is no better than the best so far with a null window,
+      // and only search it properly if that fails
+      score = -negamax(-alpha - 1, -alpha, depth - 1, ply + 1);
+      if (score > alpha && score < beta)
+        score = -negamax(-beta, -alpha, depth - 1, ply + 1);
+    }
+    board.unmake_move();
+
+    if (aborted())
+      return 0;
+    if (score > best_score)
+      best_score = score;
+    if (score <= alpha) {
+      if (quiet)
+        quiets_tried.push_back(move);
+      continue;
+    }
+
+    alpha = score;
+    best_move = move;
+    pv[ply][ply] = move;
+    std::copy(pv[ply + 1] + ply + 1, pv[ply + 1] + pv_length[ply + 1],
+              pv[ply] + ply + 1);
+    pv_length[ply] = pv_length[ply + 1];
+    if (score >= beta) {
+      stats.beta_cutoffs++;
+      stats.first_move_cutoffs += move_count == 1;
+      if (quiet)
+        update_quiet_heuristics(move, quiets_tried, depth, ply, last_move);
+      break;
+    }
+    if (quiet)
+      quiets_tried.push_back(move);
+  }
+
+  if (move_count == 0)
+    return in_check ? -mate_score + ply : 0;
+
+  const Bound bound = best_score >= beta                ? BoundLower
+                      : best_move != PackedMove::none() ? BoundExact
+                                                        : BoundUpper;
+  tt.store(key, best_move, score_to_tt(best_score, ply), static_eval, depth,
+           bound);
+  return best_score;
+}
+
+void Search::update_quiet_heuristics(const PackedMove move,
+                                     const MoveList &quiets_tried,
+                                     const int depth, const int ply,
+                                     const PackedMove last_move) {
+  if (killers[ply][0] != move) {
+    killers[ply][1] = killers[ply][0];
+    killers[ply][0] = move;
+  }
+  if (last_move != PackedMove::none())
+    counter_moves[board.get_piece(last_move.to())][last_move.to()] = move;
+
+  // deeper cutoffs say more, and the quiet moves tried first were wrong
+  const int bonus = std::min(16 * depth * depth, max_history_bonus);
+  const colour_t side = board.get_side_to_move();
+  history.update(side, move, bonus);
+  for (const PackedMove tried : quiets_tried)
+    history.update(side, tried, -bonus);
+}
+
+int Search::quiescence(int alpha, const int beta, const int ply) {
+  const bool pv_node = beta - alpha > 1;
+  pv_length[ply] = ply;
+  nodes.store(nodes.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+  seldepth = std::max(seldepth, ply);
+
+  if (should_stop())
+    return 0;
+  const bool in_check = board.in_check();
+  if (ply >= max_ply)
+    return in_check ? 0 : evaluate();
+
+  const uint64_t key = board.get_hash();
+  TTData tt_data{};
+  const bool tt_hit = tt.probe(key, tt_data);
+  if (tt_hit && !pv_node) {
+    const int tt_score = score_from_tt(tt_data.score, ply);
+    if (tt_data.bound == BoundExact ||
+        (tt_data.bound == BoundLower && tt_score >= beta) ||
+        (tt_data.bound == BoundUpper && tt_score <= alpha))
+      return tt_score;
+  }
+
+  // out of check the side to move doesn't have to capture, so the static
+  // evaluation is a lower bound on the score (standing pat)
+  int static_eval = no_eval;
+  int best_score = -infinite_score;
+  if (!in_check) {
+    static_eval =
+        tt_hit && tt_data.eval != no_eval ? tt_data.eval : evaluate();
+    if (static_eval >= beta)
+      return static_eval;
+    alpha = std::max(alpha, static_eval);
+    best_score = static_eval;
+  }
+
+  MovePicker picker(board, tt_hit ? tt_data.move : PackedMove::none(),
+                    MovePicker::CapturesOnly);
+  PackedMove best_move = PackedMove::none();
+  int move_count = 0;
+
+  PackedMove move;
+  while ((move = picker.next_move()) != PackedMove::none()) {
+    // delta pruning: skip a capture which can't bring the score back up to
+    // alpha even if the piece is won for free
+    if (!in_check && !move.is_promotion()) {
+      const int captured = move.type() == EnPassant
+                               ? see_values[Pawn]
+                               : see_values[piece_type(
+                                     board.get_piece(move.to()))];
+      if (static_eval + captured + delta_margin <= alpha)
+        continue;
+    }
+    if (!board.is_legal(move))
+      continue;
+    board.make_move(move);
+    move_count++;
+    const int score = -quiescence(-beta, -alpha, ply + 1);
+    board.unmake_move();
+
+    if (aborted())
+      return 0;
+    if (score <= best_score)
+      continue;
+    best_score = score;
+    if (score <= alpha)
+      continue;
+
+    alpha = score;
+    best_move = move;
+    pv[ply][ply] = move;
+    std::copy(pv[ply + 1] + ply + 1, pv[ply + 1] + pv_length[ply + 1],
+              pv[ply] + ply + 1);
+    pv_length[ply] = pv_length[ply + 1];
+    if (score >= beta)
+      break;
+  }
+
+  // checkmate: in check every evasion was tried
+  if (in_check && move_count == 0)
+    return -mate_score + ply;
+
+  const Bound bound = best_score >= beta                ? BoundLower
+                      : best_move != PackedMove::none() ? BoundExact
+                                                        : BoundUpper;
+  tt.store(key, best_move, score_to_tt(best_score, ply), static_eval, 0,
+           bound);
+  return best_score;
+}
+
+int Search::evaluate() {
+  const int score = nnue_network.is_loaded()
+                        ? board.nnue_evaluation()
+                        : board.static_evaluation(pawn_table);
+  return score * board.get_side_to_move();
+}
+
+bool Search::skip_depth(const int depth) const {
+  if (thread_index == 0)
+    return false;
+  const int i = (thread_index - 1) % skip_patterns;
+  return (depth + skip_phase[i]) / skip_size[i] % 2 != 0;
+}
+
+bool Search::should_stop() {
+  if (root_depth == 1)
+    return false;
+  if (thread_index == 0 && !pool.is_pondering() &&
+      get_nodes() % limit_check_nodes == 0 &&
+      ((limits.nodes && pool.get_nodes() >= limits.nodes) ||
+       pool.get_time_manager().past_hard_limit(pool.elapsed_ms())))
+    pool.stop();
+  return pool.is_stopped();
+}
+
+bool Search::aborted() const { return root_depth > 1 && pool.is_stopped(); }
+
+SearchPool::SearchPool(const int threads) { set_threads(threads); }
+
+SearchPool::~SearchPool() = default;
+
+void SearchPool::set_threads(const int new_threads) {
+  assert(new_threads > 0);
+  threads = new_threads;
+  helpers.reset();
+  if (threads > 1)
+    helpers = std::make_unique<ThreadPool>(threads - 1);
+  searches.clear();
+  for (int i = 0; i < threads; ++i)
+    searches.push_back(std::make_unique<Search>(*this, i));
+}
+
+void SearchPool::clear() {
+  for (const std::unique_ptr<Search> &search : searches)
+    search->clear();
+  if (tt.size_mb() != 0)
+    tt.clear();
+}
+
+void SearchPool::start(const Board &board, const SearchLimits &limits) {
+  start_time = std::chrono::steady_clock::now();
+  stopped.store(false, std::memory_order_relaxed);
+  pondering.store(limits.ponder, std::memory_order_relaxed);
+  time_manager.start(limits, board.generate_legal_moves().size());
+}
+
+SearchResult SearchPool::run(const Board &board, const SearchLimits &limits,
+                             const InfoCallback &on_info) {
+  if (tt.size_mb() == 0)
+    tt.resize(TranspositionTable::default_mb);
+  tt.new_search();
+
+  std::vector<SearchResult> results(threads);
+  for (int i = 1; i < threads; ++i)
+    helpers->submit([this, i, &board, &limits, &results](int) {
+      results[i] = searches[i]->run(board, limits, nullptr);
+    });
+
+  results[0] = searches[0]->run(board, limits, on_info);
+  // the main thread is done, so the helpers are too
+  stop();
+  if (helpers)
+    helpers->wait();
+
+  SearchResult result = results[pick_result(results)];
+  result.nodes = get_nodes();
+  return result;
+}
+
+size_t SearchPool::pick_result(const std::vector<SearchResult> &results) const {
+  // each thread votes for its move, with the weight of its score (above the
+  // worst score any thread found) and its depth
+  int min_score = infinite_score;
+  for (const SearchResult &result : results)
+    if (result.depth > 0)
+      min_score = std::min(min_score, result.score);
+  std::vector<std::pair<PackedMove, int64_t>> votes;
+  const auto votes_for = [&votes](const PackedMove move) -> int64_t & {
+    for (auto &[voted, count] : votes)
+      if (voted == move)
+        return count;
+    return votes.emplace_back(move, 0).second;
+  };
+  for (const SearchResult &result : results)
+    if (result.depth > 0)
+      votes_for(result.best_move) +=
+          int64_t(result.score - min_score + 14) * result.depth;
+
+  size_t best = 0;
+  for (size_t i = 1; i < results.size(); ++i) {
+    const SearchResult &candidate = results[i];
+    const SearchResult &current = results[best];
+    if (candidate.depth == 0)
+      continue;
+    // a proven mate beats any vote, and the quickest one wins
+    if (candidate.score >= mate_bound || current.score >= mate_bound) {
+      if (candidate.score > current.score)
+        best = i;
+    } else if (votes_for(candidate.best_move) >
+               votes_for(current.best_move)) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+uint64_t SearchPool::get_nodes() const {
+  uint64_t total = 0;
+  for (const std::unique_ptr<Search> &search : searches)
+    total += search->get_nodes();
+  return total;
+}
+
+int64_t SearchPool::elapsed_ms() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start_time)
+      .count();
+}
@@ -0,0 +1,234 @@
+
+#pragma once
+
+#include "board.hpp"
+#include "move.hpp"
+#include "move_picker.hpp"
+#include "pawns.hpp"
+#include "thread_pool.hpp"
+#include "time_manager.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// the deepest a search goes below the root, counting extensions
+constexpr int max_ply = 128;
+
+// scores are in centipawns from the side to move's point of view; a mate in n
+// plies scores mate_score - n, so nearer mates score higher
+constexpr int infinite_score = 32001;
+constexpr int mate_score = 32000;
+constexpr int mate_bound = mate_score - max_ply;
+// the static evaluation stored with a position which wasn't evaluated
+constexpr int no_eval = -infinite_score - 1;
+
+constexpr bool is_mate_score(const int score) {
+  return score >= mate_bound || score <= -mate_bound;
+}
+
+// how many nodes the main thread searches between looks at the clock and the
+// node limit
+constexpr uint64_t limit_check_nodes = 1024;
+
+// when a search should stop: the iteration in progress is abandoned as soon
+// as any limit is reached, and a limit of 0 means no limit. The node limit
+// counts every thread's nodes and, like the clock, is checked every so many
+// nodes, so it may be overshot a little.
+struct SearchLimits {
+  int depth = max_ply - 1;
+  uint64_t nodes = 0;
+  int64_t movetime_ms = 0;
+  // the side to move's clock, which the TimeManager shares out: a negative
+  // time left means there is no clock
+  int64_t time_left_ms = -1;
+  int64_t increment_ms = 0;
+  // moves to play before the clock is topped up, 0 for the rest of the game
+  int moves_to_go = 0;
+  // start out pondering: the limits other than depth are ignored until
+  // SearchPool::ponderhit() is called
+  bool ponder = false;
+};
+
+// how well the moves were ordered: with good ordering over 90% of the beta
+// cutoffs come from the first move searched
+struct SearchStats {
+  uint64_t beta_cutoffs = 0;
+  uint64_t first_move_cutoffs = 0;
+};
+
+// what one iteration of iterative deepening found
+struct SearchInfo {
+  int depth;
+  // the deepest ply reached
+  int seldepth;
+  int score;
+  uint64_t nodes;
+  int64_t time_ms;
+  uint64_t nps;
+  std::vector<PackedMove> pv;
+  // the main thread's, over the search so far
+  SearchStats stats;
+};
+
+struct SearchResult {
+  // none if the root position has no legal moves
+  PackedMove best_move = PackedMove::none();
+  // the reply expected to best_move, if the PV has one
+  PackedMove ponder_move = PackedMove::none();
+  int score = 0;
+  int depth = 0;
+  // searched by every thread
+  uint64_t nodes = 0;
+};
+
+using InfoCallback = std::function<void(const SearchInfo &)>;
+
+// writes an iteration as a UCI "info" line
+void print_info(std::ostream &out, const SearchInfo &info);
+
+class SearchPool;
+
+// An iterative deepening principal variation search, run by one thread of a
+// SearchPool. Each iteration searches the first move of a node
+// with the full window and the rest with a null window around alpha, searching
+// again only if one beats it. From depth 4 the root window is centred on the
+// previous iteration's score (an aspiration window) and widened when the score
+// falls outside it. At depth 0 a quiescence search resolves the captures left
+// hanging, so that leaves are only scored in quiet positions. Results are
+// shared with later iterations, later searches and the other threads through
+// tt.
+class Search {
+public:
+  // thread 0 is the main thread, which checks the limits and reports
+  // progress; the others are helpers, which skip some depths and otherwise
+  // just fill tt until the pool stops them
+  Search(SearchPool &pool, const int thread_index);
+
+  // searches board until a limit is reached or the pool is stopped, calling
+  // on_info after every completed iteration
+  SearchResult run(const Board &board, const SearchLimits &limits,
+                   const InfoCallback &on_info);
+  // forgets the move ordering learnt from earlier searches
+  void clear();
+
+  // may be read by other threads while the search runs
+  uint64_t get_nodes() const { return nodes.load(std::memory_order_relaxed); }
+
+private:
+  // the score of the position within (alpha, beta), depth plies deep
+  int negamax(int alpha, int beta, int depth, const int ply);
+  // the score of a position once depth has run out: only captures and
+  // promotions are searched (and every evasion in check), until the side to
+  // move would rather stand pat on the static evaluation than capture
+  int quiescence(int alpha, const int beta, const int ply);
+  // the root search of one iteration, through an aspiration window around
+  // the previous iteration's score
+  int aspiration_search(const int depth, const int previous_score);
+  // after a quiet move caused a beta cutoff: makes it a killer and the
+  // counter move to last_move, and rewards it in the history at the expense
+  // of the quiet moves tried before it
+  void update_quiet_heuristics(const PackedMove move,
+                               const MoveList &quiets_tried, const int depth,
+                               const int ply, const PackedMove last_move);
+  // the side to move's view of the static evaluation
+  int evaluate();
+  // whether a helper leaves this depth to the other threads
+  bool skip_depth(const int depth) const;
+  // whether the search should stop: the main thread also checks the limits,
+  // looking at the clock and node counts every so many nodes. The first
+  // iteration always finishes, so there is a move to play.
+  bool should_stop();
+  // whether the iteration in progress is being abandoned
+  bool aborted() const;
+
+  Board board;
+  SearchPool &pool;
+  const int thread_index;
+  SearchLimits limits;
+  // only ever written by this thread, so a load and a store are enough
+  std::atomic<uint64_t> nodes{0};
+  // the depth of the iteration in progress
+  int root_depth = 0;
+  int seldepth = 0;
+  SearchStats stats;
+
+  // the move ordering state, kept from one search to the next: two killer
+  // moves per ply, the history, and the counter move to each move by the
+  // piece that made it and its to square
+  PackedMove killers[max_ply + 1][2];
+  ButterflyHistory history;
+  PackedMove counter_moves[16][64];
+  // the pawn structure of the positions this thread has evaluated
+  PawnHashTable pawn_table;
+
+  // the triangular PV table: pv[ply] holds the best line found from ply,
+  // pv_length[ply] moves long, and is built from pv[ply + 1] on the way back
+  // up the tree
+  PackedMove pv[max_ply + 1][max_ply + 1];
+  int pv_length[max_ply + 1];
+};
+
+// Runs a search on one or more threads (Lazy SMP). Every thread searches the
+// whole tree from its own copy of the board, with its own move ordering
+// state, and the threads only cooperate through tt: what one thread stores
+// cuts the others' trees short. Helper threads skip some depths so that they
+// tend to be ahead of the main thread, filling the table with what it will
+// need next. Once the main thread stops, the move is chosen by a vote over
+// every thread's result, weighted by depth and score.
+class SearchPool {
+public:
+  // the UCI Threads option: the calling thread counts as one
+  explicit SearchPool(const int threads = 1);
+  ~SearchPool();
+
+  // may only be called while no search is running
+  void set_threads(const int threads);
+  // forgets everything learnt from earlier searches, for a new game: may only
+  // be called while no search is running
+  void clear();
+  int get_threads() const { return threads; }
+
+  // gets a search of board ready to run: clears any stop or ponderhit left
+  // from the last search and starts the clock. Called on the thread that will
+  // send stop and ponderhit, before the search is handed to another thread,
+  // so that one sent straight away is not lost.
+  void start(const Board &board, const SearchLimits &limits);
+  // searches board, after start() with the same limits, until a limit is
+  // reached or stop() is called, calling on_info after every iteration the
+  // main thread completes
+  SearchResult run(const Board &board, const SearchLimits &limits,
+                   const InfoCallback &on_info = nullptr);
+  // asks a running search to stop: safe to call from another thread
+  void stop() { stopped.store(true, std::memory_order_relaxed); }
+  bool is_stopped() const { return stopped.load(std::memory_order_relaxed); }
+  // the opponent played the move we were pondering on: the search goes on,
+  // now within its limits. Safe to call from another thread.
+  void ponderhit() { pondering.store(false, std::memory_order_relaxed); }
+  bool is_pondering() const {
+    return pondering.load(std::memory_order_relaxed);
+  }
+
+  // the nodes searched so far by every thread
+  uint64_t get_nodes() const;
+  int64_t elapsed_ms() const;
+  // the limits of the current or last search
+  TimeManager &get_time_manager() { return time_manager; }
+
+private:
+  // the thread whose result to play, by vote
+  size_t pick_result(const std::vector<SearchResult> &results) const;
+
+  int threads;
+  // runs the helpers: the main thread's search runs on the calling thread
+  std::unique_ptr<ThreadPool> helpers;
+  std::vector<std::unique_ptr<Search>> searches;
+  std::atomic<bool> stopped{false};
+  std::atomic<bool> pondering{false};
+  std::chrono::steady_clock::time_point start_time;
+  TimeManager time_manager;
+};
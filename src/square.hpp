@@ -1,6 +1,10 @@
 
 #pragma once
 
+#include "colour.hpp"
+
+#include <array>
+#include <cstdint>
 #include <string>
 
 /*
@@ -95,5 +99,41 @@ constexpr int square_file(const square_t sq) { return sq % 8; }
 // Return the rank (rank 1 - rank 8) -> (0 - 7)
 constexpr int square_rank(const square_t sq) { return 7 - sq / 8; }
 
+// one bit per square, bit i set <=> square i is in the set
+using bitboard_t = uint64_t;
+
+// the squares reached from each square by the given (file, rank) steps,
+// leaving out the steps that would go off the board
+template <size_t N>
+constexpr std::array<bitboard_t, 64>
+make_step_table(const int (&steps)[N][2]) {
+  std::array<bitboard_t, 64> table{};
+  for (square_t sq = 0; sq < 64; ++sq) {
+    for (const auto &step : steps) {
+      const int file = square_file(sq) + step[0];
+      const int rank = square_rank(sq) + step[1];
+      if (0 <= file && file <= 7 && 0 <= rank && rank <= 7)
+        table[sq] |= bitboard_t(1) << square_from_file_rank(file, rank);
+    }
+  }
+  return table;
+}
+
+constexpr int knight_steps[8][2] = {{1, 2},  {2, 1},  {-1, -2}, {-2, -1},
+                                    {1, -2}, {-1, 2}, {-2, 1},  {2, -1}};
+constexpr int king_steps[8][2] = {{1, 0},  {1, 1},   {1, -1}, {0, 1},
+                                  {0, -1}, {-1, 1},  {-1, 0}, {-1, -1}};
+constexpr int white_pawn_steps[2][2] = {{-1, 1}, {1, 1}};
+constexpr int black_pawn_steps[2][2] = {{-1, -1}, {1, -1}};
+
+// the squares a knight or king on a square attacks, and the squares a pawn
+// of each colour (by colour_index) captures on
+constexpr std::array<bitboard_t, 64> knight_attack_table =
+    make_step_table(knight_steps);
+constexpr std::array<bitboard_t, 64> king_attack_table =
+    make_step_table(king_steps);
+constexpr std::array<bitboard_t, 64> pawn_attack_table[2] = {
+    make_step_table(white_pawn_steps), make_step_table(black_pawn_steps)};
+
 square_t string_to_square(const std::string &str);
 std::string string_from_square(const square_t sq);
@@ -0,0 +1,89 @@
+
+#include "thread_pool.hpp"
+
+#include <cassert>
+#include <utility>
+
+ThreadPool::ThreadPool(const int threads) {
+  assert(threads > 0);
+  for (int i = 0; i < threads; ++i)
+    workers.push_back(std::make_unique<Worker>());
+  // only start the threads once every deque exists, since they steal
+  for (int i = 0; i < threads; ++i)
+    workers[i]->thread = std::thread(&ThreadPool::worker_loop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    stopping = true;
+  }
+  work_available.notify_all();
+  for (auto &worker : workers)
+    worker->thread.join();
+}
+
+void ThreadPool::submit(Task task) {
+  Worker &worker = *workers[next_worker++ % workers.size()];
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    unfinished++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  {
+    // under the lock, so a worker can't miss the wakeup between checking
+    // for work and going to sleep
+    std::lock_guard<std::mutex> lock(state_mutex);
+    queued++;
+  }
+  work_available.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(state_mutex);
+  all_done.wait(lock, [this] { return unfinished == 0; });
+}
+
+bool ThreadPool::pop_task(const int worker, Task &task) {
+  const int count = size();
+  for (int i = 0; i < count; ++i) {
+    Worker &victim = *workers[(worker + i) % count];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.tasks.empty())
+      continue;
+    // our own newest task is the most likely to still be in cache; the
+    // oldest task of another worker is the one it would get to last
+    if (i == 0) {
+      task = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+    } else {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+    }
+    queued--;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::worker_loop(const int worker) {
+  Task task;
+  while (true) {
+    if (pop_task(worker, task)) {
+      task(worker);
+      task = nullptr;
+      std::lock_guard<std::mutex> lock(state_mutex);
+      if (--unfinished == 0)
+        all_done.notify_all();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(state_mutex);
+    work_available.wait(lock, [this] { return stopping || queued > 0; });
+    if (stopping && queued == 0)
+      return;
+  }
+}
@@ -0,0 +1,56 @@
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads with one task deque each. Submitted tasks are
+// dealt round robin; a worker runs tasks from the back of its own deque and,
+// once that is empty, steals from the front of the others', so uneven tasks
+// still keep every thread busy.
+class ThreadPool {
+public:
+  // tasks are told the index of the worker running them, so they can use
+  // per-worker state without locking
+  using Task = std::function<void(int worker)>;
+
+  explicit ThreadPool(const int threads);
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  void submit(Task task);
+  // blocks until every submitted task has finished
+  void wait();
+
+  int size() const { return static_cast<int>(workers.size()); }
+
+private:
+  struct Worker {
+    std::deque<Task> tasks;
+    std::mutex mutex;
+    std::thread thread;
+  };
+
+  bool pop_task(const int worker, Task &task);
+  void worker_loop(const int worker);
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  size_t next_worker = 0;
+
+  // guards the sleeping and finishing of workers, not the deques
+  std::mutex state_mutex;
+  std::condition_variable work_available;
+  std::condition_variable all_done;
+  // tasks sitting in deques: may dip below zero while a submit is in flight
+  std::atomic<long> queued{0};
+  size_t unfinished = 0;
+  bool stopping = false;
+};
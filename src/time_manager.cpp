@@ -0,0 +1,87 @@
+
+#include "time_manager.hpp"
+
+#include "search.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// what a move may take to reach the GUI, kept in hand on every move
+constexpr int64_t move_overhead_ms = 30;
+// the moves left to plan for when the GUI doesn't say, and the most we plan
+// for when it does
+constexpr int default_moves_to_go = 30;
+constexpr int max_moves_to_go = 50;
+// the hard limit is at most this many times the soft limit, and at most this
+// share of the clock
+constexpr int max_extension = 5;
+constexpr double max_clock_share = 0.75;
+// after this many iterations with the same best move the soft limit shrinks
+constexpr int stable_iterations_to_shrink = 6;
+// an iteration is only started within this share of the (scaled) soft limit
+constexpr double next_iteration_share = 0.5;
+
+} // namespace
+
+void TimeManager::start(const SearchLimits &limits, const int root_moves) {
+  soft_limit_ms = hard_limit_ms = 0;
+  only_move = root_moves == 1;
+  previous_best = PackedMove::none();
+  previous_score = 0;
+  best_move_changes = 0;
+  stable_iterations = 0;
+
+  if (limits.movetime_ms > 0) {
+    hard_limit_ms = limits.movetime_ms;
+    return;
+  }
+  if (limits.time_left_ms < 0)
+    return;
+
+  const int64_t available =
+      std::max<int64_t>(1, limits.time_left_ms - move_overhead_ms);
+  const int moves_to_go = limits.moves_to_go > 0
+                              ? std::min(limits.moves_to_go, max_moves_to_go)
+                              : default_moves_to_go;
+  // an even share of what is left over the moves to go, plus most of the
+  // increment, which comes back after the move
+  const int64_t share = available / moves_to_go + limits.increment_ms * 3 / 4;
+  hard_limit_ms = std::max<int64_t>(
+      1, std::min(static_cast<int64_t>(available * max_clock_share),
+                  share * max_extension));
+  // with one move to go, there is no need to save anything
+  if (moves_to_go == 1)
+    hard_limit_ms = available;
+  soft_limit_ms = std::min(share, hard_limit_ms);
+}
+
+bool TimeManager::stop_after_iteration(const int depth, const int score,
+                                       const PackedMove best_move,
+                                       const int64_t elapsed_ms) {
+  const bool changed = depth > 1 && best_move != previous_best;
+  best_move_changes = best_move_changes / 2 + changed;
+  stable_iterations = changed ? 0 : stable_iterations + 1;
+  const int score_drop = depth > 1 ? previous_score - score : 0;
+  previous_best = best_move;
+  previous_score = score;
+
+  if (soft_limit_ms == 0)
+    return false;
+  // there is nothing to think about
+  if (only_move)
+    return true;
+
+  // up to twice as long while the best move is unsettled, and up to half as
+  // long again while the score falls
+  double scale = 1 + std::min(best_move_changes, 1.0);
+  scale *= 1 + std::clamp(score_drop, 0, 100) / 200.0;
+  // the move has stood up to several iterations: it is most likely right
+  if (stable_iterations >= stable_iterations_to_shrink && score_drop <= 0)
+    scale *= 0.5;
+  // the next iteration would most likely take longer than all the ones
+  // before it together, so only start it with over half the time left
+  const int64_t target =
+      std::min(static_cast<int64_t>(soft_limit_ms * scale), hard_limit_ms);
+  return elapsed_ms >= target * next_iteration_share;
+}
@@ -0,0 +1,52 @@
+
+#pragma once
+
+#include "move.hpp"
+
+#include <cstdint>
+
+struct SearchLimits;
+
+// Decides how long a search may think on a clock. It sets two limits when the
+// search starts: the soft limit is the time we aim to spend, checked between
+// iterations of iterative deepening, and the hard limit is the most we will
+// spend, checked while an iteration runs. The soft limit is then scaled after
+// every iteration: up when the best move keeps changing or the score is
+// dropping, down when the same move has stayed best for many iterations.
+//
+// The search only reads the clock every so many nodes, so checking the hard
+// limit costs a fraction of a clock read per node.
+class TimeManager {
+public:
+  // sets the limits for a search of a position with root_moves legal moves.
+  // With a fixed movetime the hard limit is the movetime and there is no
+  // soft limit; without a clock or movetime there are no limits at all.
+  void start(const SearchLimits &limits, const int root_moves);
+
+  // after an iteration: whether to stop rather than start another, given
+  // its result and the time spent so far
+  bool stop_after_iteration(const int depth, const int score,
+                            const PackedMove best_move,
+                            const int64_t elapsed_ms);
+  // during an iteration: whether the time is up
+  inline bool past_hard_limit(const int64_t elapsed_ms) const {
+    return hard_limit_ms && elapsed_ms >= hard_limit_ms;
+  }
+
+  // in milliseconds from the start of the search, 0 for no limit
+  int64_t get_soft_limit() const { return soft_limit_ms; }
+  int64_t get_hard_limit() const { return hard_limit_ms; }
+
+private:
+  int64_t soft_limit_ms = 0;
+  int64_t hard_limit_ms = 0;
+  bool only_move = false;
+
+  PackedMove previous_best = PackedMove::none();
+  int previous_score = 0;
+  // how often the best move changed lately: each change adds one and each
+  // iteration halves it
+  double best_move_changes = 0;
+  // iterations since the best move last changed
+  int stable_iterations = 0;
+};
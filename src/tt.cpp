@@ -0,0 +1,201 @@
+
+#include "tt.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+TranspositionTable tt;
+
+namespace {
+
+// data word layout, from the lowest bit: move (16), score (16), static eval
+// (16), depth (8), bound (2), age (6)
+constexpr int score_shift = 16;
+constexpr int eval_shift = 32;
+constexpr int depth_shift = 48;
+constexpr int bound_shift = 56;
+constexpr int age_shift = 58;
+constexpr uint8_t age_mask = 63;
+
+constexpr uint64_t pack_data(const PackedMove move, const int score,
+                             const int eval, const int depth, const Bound bound,
+                             const uint8_t age) {
+  return uint64_t(move.raw()) |
+         uint64_t(static_cast<uint16_t>(score)) << score_shift |
+         uint64_t(static_cast<uint16_t>(eval)) << eval_shift |
+         uint64_t(static_cast<uint8_t>(depth)) << depth_shift |
+         uint64_t(bound) << bound_shift | uint64_t(age) << age_shift;
+}
+
+constexpr int data_depth(const uint64_t data) {
+  return static_cast<int8_t>(data >> depth_shift);
+}
+constexpr Bound data_bound(const uint64_t data) {
+  return static_cast<Bound>((data >> bound_shift) & 3);
+}
+constexpr uint8_t data_age(const uint64_t data) {
+  return static_cast<uint8_t>(data >> age_shift);
+}
+
+constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+// memory for a table of bytes, a whole number of huge pages, or null if there
+// isn't that much to be had
+void *allocate(const size_t bytes, bool &with_mmap) {
+#ifdef __linux__
+  // explicit huge pages need to be reserved by the administrator, so fall back
+  // to asking for transparent huge pages on an ordinary mapping
+  void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (memory == MAP_FAILED) {
+    memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory != MAP_FAILED)
+      madvise(memory, bytes, MADV_HUGEPAGE);
+  }
+  if (memory != MAP_FAILED) {
+    with_mmap = true;
+    return memory;
+  }
+#endif
+  with_mmap = false;
+  return std::aligned_alloc(huge_page_size, bytes);
+}
+
+} // namespace
+
+TranspositionTable::~TranspositionTable() { free_buckets(); }
+
+void TranspositionTable::free_buckets() {
+  if (!buckets)
+    return;
+#ifdef __linux__
+  if (allocated_with_mmap)
+    munmap(buckets, allocated_bytes);
+  else
+#endif
+    std::free(buckets);
+  buckets = nullptr;
+  bucket_count = allocated_bytes = 0;
+}
+
+bool TranspositionTable::resize(const size_t mb) {
+  const size_t previous_bytes = allocated_bytes;
+  free_buckets();
+  // whole huge pages, and at least one of them
+  const size_t wanted_bytes =
+      std::max(mb << 20, huge_page_size) / huge_page_size * huge_page_size;
+
+  // the table is cleared either way, so falling back to the size it had loses
+  // nothing; failing that, or with no table before, to ever smaller ones
+  size_t bytes = wanted_bytes;
+  bool with_mmap = false;
+  void *memory = allocate(bytes, with_mmap);
+  if (!memory && previous_bytes) {
+    bytes = previous_bytes;
+    memory = allocate(bytes, with_mmap);
+  }
+  while (!memory && bytes > huge_page_size) {
+    bytes = std::max(bytes / 2 / huge_page_size * huge_page_size,
+                     huge_page_size);
+    memory = allocate(bytes, with_mmap);
+  }
+  // every search needs a table, so there is no going on without one
+  if (!memory) {
+    std::cerr << "out of memory for the transposition table" << std::endl;
+    std::abort();
+  }
+
+  buckets = static_cast<TTBucket *>(memory);
+  allocated_with_mmap = with_mmap;
+  allocated_bytes = bytes;
+  bucket_count = bytes / sizeof(TTBucket);
+  clear();
+  return bytes == wanted_bytes;
+}
+
+void TranspositionTable::clear() {
+  std::memset(static_cast<void *>(buckets), 0,
+              bucket_count * sizeof(TTBucket));
+  age = 0;
+}
+
+void TranspositionTable::new_search() { age = (age + 1) & age_mask; }
+
+bool TranspositionTable::probe(const uint64_t key, TTData &result) const {
+  const TTBucket *bucket = bucket_of(key);
+  for (const TTEntry &entry : bucket->entries) {
+    const uint64_t data = entry.data.load(std::memory_order_relaxed);
+    const uint64_t check = entry.check.load(std::memory_order_relaxed);
+    if ((check ^ data) != key || data_bound(data) == BoundNone)
+      continue;
+    result.move = PackedMove(static_cast<uint16_t>(data));
+    result.score = static_cast<int16_t>(data >> score_shift);
+    result.eval = static_cast<int16_t>(data >> eval_shift);
+    result.depth = data_depth(data);
+    result.bound = data_bound(data);
+    return true;
+  }
+  return false;
+}
+
+void TranspositionTable::store(const uint64_t key, PackedMove move,
+                               const int score, const int eval,
+                               const int depth, const Bound bound) {
+  TTBucket *bucket = bucket_of(key);
+  TTEntry *replace = nullptr;
+  int replace_value = 0;
+
+  for (TTEntry &entry : bucket->entries) {
+    const uint64_t data = entry.data.load(std::memory_order_relaxed);
+    const uint64_t check = entry.check.load(std::memory_order_relaxed);
+    if ((check ^ data) == key) {
+      // same position: keep the old best move if we have none, and don't let
+      // a shallow bound overwrite a deeper result from this search
+      if (move == PackedMove::none())
+        move = PackedMove(static_cast<uint16_t>(data));
+      if (bound != BoundExact && data_age(data) == age &&
+          depth + 4 < data_depth(data))
+        return;
+      replace = &entry;
+      break;
+    }
+    // otherwise replace the shallowest entry, counting entries from older
+    // searches as shallower still; empty entries go first
+    const int value =
+        data_bound(data) == BoundNone
+            ? -1024
+            : data_depth(data) - 8 * ((age - data_age(data)) & age_mask);
+    if (!replace || value < replace_value) {
+      replace = &entry;
+      replace_value = value;
+    }
+  }
+
+  const uint64_t data = pack_data(move, score, eval, depth, bound, age);
+  replace->data.store(data, std::memory_order_relaxed);
+  replace->check.store(key ^ data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+  constexpr int sample_buckets = 1000 / tt_bucket_size;
+  const size_t buckets_to_check =
+      std::min(bucket_count, static_cast<size_t>(sample_buckets));
+  int used = 0;
+  for (size_t i = 0; i < buckets_to_check; ++i) {
+    for (const TTEntry &entry : buckets[i].entries) {
+      const uint64_t data = entry.data.load(std::memory_order_relaxed);
+      used += data_bound(data) != BoundNone && data_age(data) == age;
+    }
+  }
+  return buckets_to_check ? used * 1000 /
+                                static_cast<int>(buckets_to_check *
+                                                 tt_bucket_size)
+                          : 0;
+}
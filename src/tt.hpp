@@ -0,0 +1,99 @@
+
+#pragma once
+
+#include "move.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// what a stored score says about the true score of the position
+enum Bound {
+  BoundNone = 0,
+  // the true score is at most the stored score (failed low)
+  BoundUpper = 1,
+  // the true score is at least the stored score (failed high)
+  BoundLower = 2,
+  BoundExact = BoundUpper | BoundLower
+};
+
+// the unpacked contents of a transposition table entry
+struct TTData {
+  PackedMove move;
+  int score;
+  int eval;
+  int depth;
+  Bound bound;
+};
+
+// A transposition table entry is two 64-bit words: data packs the move,
+// score, static eval, depth, bound and age, and check holds the position's
+// key XORed with data. Each word is written atomically but the pair is not, so
+// a torn write by another thread shows up as a check that no longer matches
+// the key, and the entry reads as a miss (the lockless hashing trick).
+struct TTEntry {
+  std::atomic<uint64_t> check;
+  std::atomic<uint64_t> data;
+};
+
+// four entries fill one 64 byte cache line, so a probe touches one line
+constexpr int tt_bucket_size = 4;
+struct alignas(64) TTBucket {
+  TTEntry entries[tt_bucket_size];
+};
+static_assert(sizeof(TTBucket) == 64);
+
+// A hash table of search results keyed on Board::get_hash(), shared between
+// search threads without locks. Sized in megabytes; the memory is backed by
+// huge pages where the OS allows it.
+class TranspositionTable {
+  TTBucket *buckets = nullptr;
+  size_t bucket_count = 0;
+  size_t allocated_bytes = 0;
+  bool allocated_with_mmap = false;
+  // bumped once per search: lets replacement prefer entries from old searches
+  uint8_t age = 0;
+
+  void free_buckets();
+
+  inline TTBucket *bucket_of(const uint64_t key) const {
+    // maps the key onto [0, bucket_count) without needing a power of two
+    __extension__ using uint128_t = unsigned __int128;
+    return buckets + static_cast<size_t>(
+                         (static_cast<uint128_t>(key) * bucket_count) >> 64);
+  }
+
+public:
+  constexpr static size_t default_mb = 16;
+
+  TranspositionTable() = default;
+  TranspositionTable(const TranspositionTable &) = delete;
+  TranspositionTable &operator=(const TranspositionTable &) = delete;
+  ~TranspositionTable();
+
+  // reallocates the table to (at most) mb megabytes, which also clears it.
+  // If that much memory can't be had, the table keeps its old size (or, if
+  // there was no table, gets the largest smaller one there is memory for)
+  // and false is returned.
+  bool resize(const size_t mb);
+  void clear();
+  void new_search();
+
+  // on a hit fills data and returns true
+  bool probe(const uint64_t key, TTData &data) const;
+  void store(const uint64_t key, const PackedMove move, const int score,
+             const int eval, const int depth, const Bound bound);
+
+  // starts loading the bucket of key into the cache ahead of a probe
+  inline void prefetch(const uint64_t key) const {
+    __builtin_prefetch(bucket_of(key));
+  }
+
+  // how full the table is in permille, sampled from entries written by the
+  // current search (as UCI's "info hashfull" expects)
+  int hashfull() const;
+  size_t size_mb() const { return allocated_bytes >> 20; }
+};
+
+// the table shared by every search thread
+extern TranspositionTable tt;
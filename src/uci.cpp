@@ -0,0 +1,277 @@
+
+#include "uci.hpp"
+
+#include "nnue.hpp"
+#include "tt.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+constexpr size_t max_hash_mb = 65536;
+constexpr int max_threads = 256;
+
+} // namespace
+
+Uci::Uci(std::istream &in, std::ostream &out) : in(in), out(out) {
+  if (tt.size_mb() == 0)
+    tt.resize(TranspositionTable::default_mb);
+}
+
+Uci::~Uci() { stop_search(); }
+
+void Uci::loop() {
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!handle_command(line))
+      return;
+  }
+  stop_search();
+}
+
+bool Uci::handle_command(const std::string &line) {
+  std::istringstream args(line);
+  std::string command;
+  args >> command;
+
+  if (command == "uci") {
+    handle_uci();
+  } else if (command == "isready") {
+    send("readyok");
+  } else if (command == "ucinewgame") {
+    stop_search();
+    search.clear();
+    position_fen.clear();
+    position_moves.clear();
+  } else if (command == "setoption") {
+    stop_search();
+    handle_setoption(args);
+  } else if (command == "position") {
+    stop_search();
+    handle_position(args);
+  } else if (command == "go") {
+    stop_search();
+    handle_go(args);
+  } else if (command == "stop") {
+    stop_search();
+  } else if (command == "ponderhit") {
+    search.ponderhit();
+    {
+      std::lock_guard<std::mutex> lock(release_mutex);
+      released = true;
+    }
+    release_condition.notify_all();
+  } else if (command == "quit") {
+    stop_search();
+    return false;
+  } else if (!command.empty() && command != "debug" && command != "register") {
+    send("info string unknown command " + command);
+  }
+  return true;
+}
+
+void Uci::handle_uci() {
+  send("id name starfish");
+  send("id author the starfish authors");
+  send("option name Hash type spin default " +
+       std::to_string(TranspositionTable::default_mb) + " min 1 max " +
+       std::to_string(max_hash_mb));
+  send("option name Threads type spin default 1 min 1 max " +
+       std::to_string(max_threads));
+  send("option name Ponder type check default false");
+  send("option name EvalFile type string default <empty>");
+  send("option name OwnBook type check default false");
+  send("option name BookFile type string default <empty>");
+  send("option name BookBestMove type check default false");
+  send("option name Clear Hash type button");
+  send("uciok");
+}
+
+void Uci::handle_setoption(std::istringstream &args) {
+  // setoption name <name> [value <value>], where both may contain spaces
+  std::string token, name, value;
+  args >> token;
+  while (args >> token && token != "value")
+    name += (name.empty() ? "" : " ") + token;
+  while (args >> token)
+    value += (value.empty() ? "" : " ") + token;
+
+  if (name == "Hash") {
+    const size_t mb = std::strtoull(value.c_str(), nullptr, 10);
+    if (!tt.resize(std::clamp<size_t>(mb, 1, max_hash_mb)))
+      send("info string not enough memory for the hash, using " +
+           std::to_string(tt.size_mb()) + " MB");
+  } else if (name == "Threads") {
+    search.set_threads(std::clamp(std::atoi(value.c_str()), 1, max_threads));
+  } else if (name == "EvalFile") {
+    if (value.empty() || value == "<empty>")
+      nnue_network.unload();
+    else if (!nnue_network.load(value))
+      send("info string could not load network " + value);
+  } else if (name == "OwnBook") {
+    own_book = value == "true";
+  } else if (name == "BookFile") {
+    if (value.empty() || value == "<empty>")
+      book.close();
+    else if (!book.open(value))
+      send("info string could not open book " + value);
+  } else if (name == "BookBestMove") {
+    book_selection = value == "true" ? BookBest : BookWeighted;
+  } else if (name == "Clear Hash") {
+    tt.clear();
+  } else if (name != "Ponder") {
+    send("info string unknown option " + name);
+  }
+}
+
+void Uci::handle_position(std::istringstream &args) {
+  std::string token, fen;
+  args >> token;
+  if (token == "startpos") {
+    fen = Board::start_fen;
+    args >> token;
+  } else if (token == "fen") {
+    while (args >> token && token != "moves")
+      fen += (fen.empty() ? "" : " ") + token;
+  } else {
+    send("info string expected startpos or fen");
+    return;
+  }
+  std::vector<std::string> moves;
+  while (args >> token)
+    moves.push_back(token);
+
+  // how much of the last position command this one repeats
+  size_t common = 0;
+  if (fen == position_fen) {
+    common = std::mismatch(position_moves.begin(), position_moves.end(),
+                           moves.begin(), moves.end())
+                 .first -
+             position_moves.begin();
+    // the state history only reaches back so far
+    if (position_moves.size() - common >
+        static_cast<size_t>(board.get_history_ply()))
+      common = 0;
+  }
+
+  if (fen == position_fen && common > 0) {
+    while (position_moves.size() > common) {
+      board.unmake_move();
+      position_moves.pop_back();
+    }
+  } else {
+    const FenError error = board.set_fen(fen);
+    if (error != FenOk) {
+      send(std::string("info string bad fen: ") + fen_error_message(error));
+      return;
+    }
+    position_fen = fen;
+    position_moves.clear();
+  }
+
+  for (size_t i = position_moves.size(); i < moves.size(); ++i) {
+    const PackedMove move = board.parse_uci_move(moves[i]);
+    if (move == PackedMove::none()) {
+      send("info string illegal move " + moves[i]);
+      return;
+    }
+    board.make_move(move);
+    position_moves.push_back(moves[i]);
+    // the search needs room for max_ply more moves
+    if (board.get_history_ply() + max_ply >= max_history)
+      board.forget_history();
+  }
+}
+
+void Uci::handle_go(std::istringstream &args) {
+  SearchLimits limits;
+  bool infinite = false;
+  int64_t time[2] = {-1, -1}, increment[2] = {0, 0};
+
+  std::string token;
+  while (args >> token) {
+    if (token == "depth")
+      args >> limits.depth;
+    else if (token == "nodes")
+      args >> limits.nodes;
+    else if (token == "movetime")
+      args >> limits.movetime_ms;
+    else if (token == "wtime")
+      args >> time[colour_index(White)];
+    else if (token == "btime")
+      args >> time[colour_index(Black)];
+    else if (token == "winc")
+      args >> increment[colour_index(White)];
+    else if (token == "binc")
+      args >> increment[colour_index(Black)];
+    else if (token == "movestogo")
+      args >> limits.moves_to_go;
+    else if (token == "infinite")
+      infinite = true;
+    else if (token == "ponder")
+      limits.ponder = true;
+  }
+  limits.depth = std::clamp(limits.depth, 1, max_ply - 1);
+
+  // the time manager only needs our clock
+  const int us = colour_index(board.get_side_to_move());
+  if (!infinite) {
+    limits.time_left_ms = time[us];
+    limits.increment_ms = increment[us];
+  }
+
+  // a book move is played at once, unless the GUI wants the search to run
+  // until it says stop
+  if (own_book && !infinite && !limits.ponder) {
+    const PackedMove move = book.probe(board, book_selection);
+    if (move != PackedMove::none()) {
+      send("bestmove " + move.to_uci());
+      return;
+    }
+  }
+
+  released = false;
+  search.start(board, limits);
+  search_thread =
+      std::thread(&Uci::search_thread_main, this, limits, infinite);
+}
+
+void Uci::search_thread_main(const SearchLimits limits, const bool infinite) {
+  const SearchResult result =
+      search.run(board, limits, [this](const SearchInfo &info) {
+        std::lock_guard<std::mutex> lock(out_mutex);
+        print_info(out, info);
+      });
+
+  // UCI forbids sending bestmove before stop (or ponderhit) in these modes,
+  // even if the search has run out of depth
+  if (infinite || limits.ponder) {
+    std::unique_lock<std::mutex> lock(release_mutex);
+    release_condition.wait(lock, [this] { return released; });
+  }
+
+  std::string line = "bestmove ";
+  line += result.best_move == PackedMove::none() ? "0000"
+                                                 : result.best_move.to_uci();
+  if (result.ponder_move != PackedMove::none())
+    line += " ponder " + result.ponder_move.to_uci();
+  send(line);
+}
+
+void Uci::stop_search() {
+  if (!search_thread.joinable())
+    return;
+  search.stop();
+  {
+    std::lock_guard<std::mutex> lock(release_mutex);
+    released = true;
+  }
+  release_condition.notify_all();
+  search_thread.join();
+}
+
+void Uci::send(const std::string &line) {
+  std::lock_guard<std::mutex> lock(out_mutex);
+  out << line << std::endl;
+}
@@ -0,0 +1,74 @@
+
+#pragma once
+
+#include "board.hpp"
+#include "book.hpp"
+#include "search.hpp"
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The Universal Chess Interface: reads commands from a GUI or match runner
+// and answers them. Searches run on a thread of their own, so that stop,
+// ponderhit and isready are answered while one is in progress.
+//
+// The position is kept between position commands: when a command repeats the
+// last one with more moves on the end, as GUIs send during a game, only the
+// new moves are played, and moves the GUI took back are unmade.
+//
+// With OwnBook on, a go in a position the opening book knows is answered with
+// the book move straight away, without starting a search.
+class Uci {
+public:
+  Uci(std::istream &in, std::ostream &out);
+  Uci(const Uci &) = delete;
+  Uci &operator=(const Uci &) = delete;
+  ~Uci();
+
+  // handles commands until quit or the end of the input
+  void loop();
+  // handles one command line: returns false on quit
+  bool handle_command(const std::string &line);
+
+private:
+  void handle_uci();
+  void handle_setoption(std::istringstream &args);
+  void handle_position(std::istringstream &args);
+  void handle_go(std::istringstream &args);
+
+  // the body of the search thread: searches, then waits for stop or
+  // ponderhit if the GUI asked for an infinite or ponder search, and sends
+  // bestmove
+  void search_thread_main(const SearchLimits limits, const bool infinite);
+  // stops any search in progress and waits for its bestmove to be sent
+  void stop_search();
+  // sends a line to the GUI: the search thread sends too, so lines go out
+  // whole under a lock
+  void send(const std::string &line);
+
+  std::istream &in;
+  std::ostream &out;
+  std::mutex out_mutex;
+
+  Board board;
+  // the FEN and moves of the last position command, which board is in
+  std::string position_fen;
+  std::vector<std::string> position_moves;
+
+  OpeningBook book;
+  bool own_book = false;
+  BookSelection book_selection = BookWeighted;
+
+  SearchPool search;
+  std::thread search_thread;
+  // set by stop and ponderhit, for a search which must not send bestmove
+  // until one of them arrives
+  std::mutex release_mutex;
+  std::condition_variable release_condition;
+  bool released = false;
+};
@@ -1,9 +0,0 @@
-
-#pragma once
-
-#include <string>
-#include <vector>
-
-std::vector<std::string> split_string(const std::string &str, const char del);
-
-std::string remove_char(const std::string &str, const char del);
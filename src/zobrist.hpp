@@ -0,0 +1,50 @@
+
+#pragma once
+
+#include "piece.hpp"
+#include "square.hpp"
+
+#include <cstdint>
+
+// Random keys for Zobrist hashing: a position's hash is the XOR of the keys of
+// every (piece, square) pair on the board, the side key if black is to move,
+// the key of the castle perms and the key of the en passant file, if a pawn
+// can take en passant. All of them are generated at compile time from a fixed
+// seed.
+
+// splitmix64, which is good enough for hashing and trivially constexpr
+constexpr uint64_t zobrist_random(uint64_t &state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+struct ZobristKeys {
+  // indexed by piece_t, so the slots between the white and black pieces are
+  // unused
+  uint64_t pieces[16][64] = {};
+  uint64_t side = 0;
+  uint64_t castle_perms[16] = {};
+  uint64_t en_passant_file[8] = {};
+};
+
+constexpr ZobristKeys make_zobrist_keys() {
+  ZobristKeys keys{};
+  uint64_t state = 0x5354415246495348ULL;
+  for (piece_t piece = 0; piece < 16; ++piece) {
+    if (piece_type(piece) > King)
+      continue;
+    for (square_t sq = 0; sq < 64; ++sq)
+      keys.pieces[piece][sq] = zobrist_random(state);
+  }
+  keys.side = zobrist_random(state);
+  // 0 (no rights) keeps a zero key so an empty set of perms costs nothing
+  for (int perms = 1; perms < 16; ++perms)
+    keys.castle_perms[perms] = zobrist_random(state);
+  for (int file = 0; file < 8; ++file)
+    keys.en_passant_file[file] = zobrist_random(state);
+  return keys;
+}
+
+constexpr ZobristKeys zobrist_keys = make_zobrist_keys();